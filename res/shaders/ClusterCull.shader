@@ -0,0 +1,43 @@
+#shader vertex
+#version 330 core
+
+// One point per cluster: its bounds and its triangles in the index buffer
+layout(location = 0) in vec3 boundsMin;
+layout(location = 1) in vec3 boundsMax;
+layout(location = 2) in uint firstTriangle;
+layout(location = 3) in uint trianglesNumber;
+
+uniform mat4 clipFromModel;
+
+// Captured by transform feedback as a DrawElementsIndirectCommand; a cluster outside the view draws no instance
+flat out uint count;
+flat out uint instanceCount;
+flat out uint firstIndex;
+flat out uint baseVertex;
+flat out uint baseInstance;
+
+void main()
+{
+	// The planes around -w <= x, y, z <= w, inside where dot(plane, vec4(p, 1.0)) >= 0
+	mat4 rows = transpose(clipFromModel);
+
+	bool visible = true;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (int side = -1; side <= 1; side += 2)
+		{
+			vec4 plane = rows[3] + float(side) * rows[axis];
+			vec3 furthest = mix(boundsMin, boundsMax, step(0.0, plane.xyz));
+			if (dot(plane.xyz, furthest) + plane.w < 0.0)
+				visible = false;
+		}
+	}
+
+	count = trianglesNumber * 3u;
+	instanceCount = visible ? 1u : 0u;
+	firstIndex = firstTriangle * 3u;
+	baseVertex = 0u;
+	baseInstance = 0u;
+
+	gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+};
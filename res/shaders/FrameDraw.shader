@@ -0,0 +1,31 @@
+#shader vertex
+#version 330 core
+
+// Corners of the model frame as drawn, with their texture coordinates
+layout(location = 0) in vec4 position;
+
+// Where pans and zooms since then have moved the frame in clip space
+uniform vec2 frameScale;
+uniform vec2 frameOffset;
+
+out vec2 textureCoord;
+
+void main()
+{
+	textureCoord = position.zw;
+	gl_Position = vec4(frameScale * position.xy + frameOffset, 0.0, 1.0);
+};
+
+#shader fragment
+#version 330 core
+
+out vec4 color;
+
+in vec2 textureCoord;
+
+uniform sampler2D frameImage;
+
+void main()
+{
+	color = texture(frameImage, textureCoord);
+};
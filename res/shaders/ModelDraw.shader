@@ -3,12 +3,87 @@
 
 layout(location = 0) in vec4 position;
 
+// The entry in partsData of the part instance drawn, an instanced attribute
+layout(location = 1) in float instanceIndex;
+
 uniform mat4 proj;
 uniform mat4 view;
 
+// Quantized positions are normalized across the model bounds, floats pass with scale 1 and offset 0
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+uniform vec4 inColor;
+
+// The parts of an assembly are drawn from pooled buffers, each as often as it is placed; 5 texels per instance
+// hold the columns of the matrix from the part's stored positions to where the instance is in model space,
+// then its colour
+uniform bool fromParts;
+uniform samplerBuffer partsData;
+
+out vec4 vertexColor;
+
+void main()
+{
+	if (fromParts)
+	{
+		int first = int(instanceIndex) * 5;
+		mat4 modelFromStored = mat4(texelFetch(partsData, first), texelFetch(partsData, first + 1),
+			texelFetch(partsData, first + 2), texelFetch(partsData, first + 3));
+
+		gl_Position = proj * view * modelFromStored * vec4(position.xyz, 1.0);
+		vertexColor = texelFetch(partsData, first + 4);
+	}
+	else
+	{
+		gl_Position = proj * view * vec4(positionScale * position.xyz + positionOffset, 1.0);
+		vertexColor = inColor;
+	}
+};
+
+#shader geometry
+#version 330 core
+
+layout(triangles) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+uniform vec2 viewportSize;
+
+in vec4 vertexColor[];
+
+// Triangles less than EDGE_FADE_START pixels across show no edges, from EDGE_FADE_END on they show them fully
+const float EDGE_FADE_START = 2.0;
+const float EDGE_FADE_END = 6.0;
+
+// Distances in pixels from the three edges, interpolated linearly on screen
+noperspective out vec3 edgeDistance;
+flat out float edgeFade;
+flat out vec4 fillColor;
+
 void main()
 {
-	gl_Position = proj * view * position;
+	vec2 p[3];
+	for (int i = 0; i < 3; i++)
+		p[i] = 0.5 * viewportSize * gl_in[i].gl_Position.xy / gl_in[i].gl_Position.w;
+
+	// A vertex is twice the area over the length of the opposite edge away from it
+	float doubleArea = abs((p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y));
+	vec3 edgeLengths = vec3(length(p[2] - p[1]), length(p[2] - p[0]), length(p[1] - p[0]));
+	vec3 heights = doubleArea / max(edgeLengths, vec3(1e-6));
+
+	// Edges of dense triangles would cover them and blacken the whole model
+	float fade = smoothstep(EDGE_FADE_START, EDGE_FADE_END, sqrt(doubleArea));
+
+	for (int i = 0; i < 3; i++)
+	{
+		gl_Position = gl_in[i].gl_Position;
+		edgeDistance = vec3(0.0);
+		edgeDistance[i] = heights[i];
+		edgeFade = fade;
+		fillColor = vertexColor[0];
+		EmitVertex();
+	}
+	EndPrimitive();
 };
 
 #shader fragment
@@ -16,9 +91,17 @@ void main()
 
 layout(location = 0) out vec4 outColor;
 
-uniform vec4 inColor;
+uniform vec4 edgesColor;
+
+noperspective in vec3 edgeDistance;
+flat in float edgeFade;
+flat in vec4 fillColor;
 
 void main()
 {
-	outColor = inColor;
+	// Each triangle draws its half of a line 1 pixel wide along its edges, smoothed over a pixel
+	float nearest = min(edgeDistance.x, min(edgeDistance.y, edgeDistance.z));
+	float edge = (1.0 - smoothstep(0.0, 1.0, nearest)) * edgeFade;
+
+	outColor = mix(fillColor, edgesColor, edge);
 };
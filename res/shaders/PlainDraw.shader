@@ -0,0 +1,52 @@
+#shader vertex
+#version 330 core
+
+layout(location = 0) in vec4 position;
+layout(location = 1) in float instanceIndex;
+
+uniform mat4 proj;
+uniform mat4 view;
+
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+uniform vec4 inColor;
+
+// Parts drawn from pooled buffers as in ModelDraw; their fill takes their own colours if partColors is set,
+// their edges take inColor
+uniform bool fromParts;
+uniform bool partColors;
+uniform samplerBuffer partsData;
+
+flat out vec4 fillColor;
+
+void main()
+{
+	if (fromParts)
+	{
+		int first = int(instanceIndex) * 5;
+		mat4 modelFromStored = mat4(texelFetch(partsData, first), texelFetch(partsData, first + 1),
+			texelFetch(partsData, first + 2), texelFetch(partsData, first + 3));
+
+		gl_Position = proj * view * modelFromStored * vec4(position.xyz, 1.0);
+		fillColor = partColors ? texelFetch(partsData, first + 4) : inColor;
+	}
+	else
+	{
+		gl_Position = proj * view * vec4(positionScale * position.xyz + positionOffset, 1.0);
+		fillColor = inColor;
+	}
+};
+
+#shader fragment
+#version 330 core
+
+// The model in one colour: its fill under the feature edges, and the edges themselves
+layout(location = 0) out vec4 outColor;
+
+flat in vec4 fillColor;
+
+void main()
+{
+	outColor = fillColor;
+};
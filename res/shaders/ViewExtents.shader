@@ -0,0 +1,34 @@
+#shader vertex
+#version 330 core
+
+layout(location = 0) in vec4 position;
+
+uniform mat4 view;
+
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+out vec3 viewPosition;
+
+void main()
+{
+	viewPosition = (view * vec4(positionScale * position.xyz + positionOffset, 1.0)).xyz;
+
+	// Every vertex lands on the single pixel of the extents target
+	gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+};
+
+#shader fragment
+#version 330 core
+
+// Blended with GL_MAX, so the pixels end up holding the largest and the negated smallest coordinates
+layout(location = 0) out vec4 maxPosition;
+layout(location = 1) out vec4 minPosition;
+
+in vec3 viewPosition;
+
+void main()
+{
+	maxPosition = vec4(viewPosition, 0.0);
+	minPosition = vec4(-viewPosition, 0.0);
+};
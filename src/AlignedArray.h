@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Alignment of the arrays the CPU passes stream through: a cache line, and a multiple of any SIMD register
+const size_t ARRAY_ALIGNMENT{ 64 };
+
+// Move-only array of a trivially copyable type in ARRAY_ALIGNMENT-aligned memory; elements start uninitialised
+template <typename T>
+class AlignedArray
+{
+    static_assert(std::is_trivially_copyable<T>::value, "AlignedArray elements are copied as bytes");
+
+public:
+    AlignedArray() = default;
+
+    explicit AlignedArray(size_t size)
+    {
+        if (size > 0)
+            m_Data = static_cast<T*>(::operator new(size * sizeof(T), std::align_val_t(ARRAY_ALIGNMENT)));
+        m_Size = size;
+    }
+
+    ~AlignedArray() { Release(); }
+
+    AlignedArray(AlignedArray&& other) noexcept
+        : m_Data(std::exchange(other.m_Data, nullptr)), m_Size(std::exchange(other.m_Size, 0))
+    {
+    }
+
+    AlignedArray& operator=(AlignedArray&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Release();
+            m_Data = std::exchange(other.m_Data, nullptr);
+            m_Size = std::exchange(other.m_Size, 0);
+        }
+        return *this;
+    }
+
+    AlignedArray(const AlignedArray&) = delete;
+    AlignedArray& operator=(const AlignedArray&) = delete;
+
+    T* Data() { return m_Data; }
+    const T* Data() const { return m_Data; }
+    size_t Size() const { return m_Size; }
+    bool Empty() const { return m_Size == 0; }
+
+    T& operator[](size_t index) { return m_Data[index]; }
+    const T& operator[](size_t index) const { return m_Data[index]; }
+
+    void Release()
+    {
+        if (m_Data != nullptr)
+            ::operator delete(m_Data, std::align_val_t(ARRAY_ALIGNMENT));
+
+        m_Data = nullptr;
+        m_Size = 0;
+    }
+
+private:
+    T* m_Data{ nullptr };
+    size_t m_Size{ 0 };
+};
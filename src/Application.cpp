@@ -3,23 +3,42 @@
 
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <float.h>
+#include <stddef.h>
+#include <stdint.h>
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <sstream>
 #include <vector>
+#include <chrono>
+#include <memory>
+#include <deque>
+#include <filesystem>
+#include <system_error>
 
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 
 #include "textures/stb_image.h"
 
+#include "Benchmark.h"
+#include "CacheJob.h"
+#include "ChunkStreamer.h"
+#include "HullJob.h"
+#include "LoadJob.h"
+#include "LodJob.h"
+#include "Mesh.h"
+#include "MeshClusters.h"
+#include "Parallel.h"
+#include "SimdKernels.h"
+
 #define ASSERT(x) if (!(x)) __debugbreak();
 
-float* modelPositions = new float[0];
-int modelPositionsLength = 0;
-int modelTrianglesNumber{ 0 };
+size_t modelTrianglesNumber{ 0 };
+size_t modelVerticesNumber{ 0 };
 
 float rotCentreX{ 0 };
 float rotCentreY{ 0 };
@@ -41,6 +60,7 @@ double mouseScroll{ 1.0 };
 bool rightMouseButtonPressed{ false };
 bool middleMouseButtonPressed{ false };
 bool toDoOptimiseView{ true };
+bool toDoPlaceInstances{ false };
 
 int glContextWidth{ 1024 };
 int glContextHeight{ 768 };
@@ -50,11 +70,273 @@ float glContextScaleY{ 1.0f };
 
 unsigned int modelVertexArray{ 0 };
 unsigned int modelVertexBuffer{ 0 };
-unsigned int modelTransformFeedback{ 0 };
+unsigned int modelElementBuffer{ 0 };
+
+// Where the model's clusters outside the view are culled: on the GPU where indirect multi-draw is supported,
+// otherwise on the CPU; 'C' switches between them and no culling
+enum class ClusterCulling
+{
+    GPU, CPU, NONE
+};
+ClusterCulling clusterCulling{ ClusterCulling::CPU };
+bool gpuClusterCullingSupported{ false };
+
+// Hierarchy over clusters of the model's triangles; the CPU walks it and draws the clusters inside the view
+// with one multi-draw
+std::vector<ClusterNode> modelClusters;
+std::vector<TriangleRange> visibleRanges;
+std::vector<int> visibleCounts;
+std::vector<const void*> visibleOffsets;
+
+// The GPU runs a point per cluster through a transform feedback pass that writes a draw command for each,
+// with no instance for one outside the view, and draws the commands without the CPU reading them back
+unsigned int clustersVertexArray{ 0 };
+unsigned int clustersVertexBuffer{ 0 };
+unsigned int clusterCommandsBuffer{ 0 };
+int clustersNumber{ 0 };
+
+// Feature edges drawn as lines from the model's vertex buffer, 2 indices per edge
+unsigned int modelEdgesVertexArray{ 0 };
+unsigned int modelEdgesElementBuffer{ 0 };
+int modelEdgesIndicesNumber{ 0 };
+
+// The shaders take positionScale * position + positionOffset as the model-space position
+float modelPositionScale[3]{ 1.0f, 1.0f, 1.0f };
+float modelPositionOffset[3]{ 0.0f, 0.0f, 0.0f };
+StlBounds modelBounds{ 0, 0, 0, 0, 0, 0 };
+VertexFormat modelVertexFormat{ VertexFormat::FLOAT };
 
 unsigned int textVertexArray{ 0 };
 unsigned int textVertexBuffer{ 0 };
 
+// The view fit reduces the view-space vertices to their extents on the GPU; the two pixels holding them
+// are read back through a pixel buffer once extentsFence signals, so the frame never waits for it
+unsigned int extentsFramebuffer{ 0 };
+unsigned int extentsRenderbuffers[2]{ 0, 0 };
+unsigned int extentsPixelBuffer{ 0 };
+GLsync extentsFence{ nullptr };
+
+const char* WINDOW_TITLE{ "STL Viewer" };
+
+std::unique_ptr<LoadJob> loadJob;
+int loadPercentShown{ -1 };
+
+// Caches of parsed models being written in the background, at most one per cache file
+std::vector<std::unique_ptr<CacheJob>> cacheJobs;
+
+// Points on the convex hull of the model, empty until hullJob computed them
+std::unique_ptr<HullJob> hullJob;
+Mesh modelHull;
+
+// A simplified level of the model on the GPU, with its feature edges
+struct ModelLod
+{
+    unsigned int vertexArray{ 0 };
+    unsigned int vertexBuffer{ 0 };
+    unsigned int elementBuffer{ 0 };
+    int trianglesNumber{ 0 };
+
+    unsigned int edgesVertexArray{ 0 };
+    unsigned int edgesElementBuffer{ 0 };
+    int edgesIndicesNumber{ 0 };
+};
+
+// Models with at least this many triangles get levels of detail, from the finest to the coarsest, once lodJob
+// built them
+const size_t LOD_MIN_MODEL_TRIANGLES{ 1 << 20 };
+std::unique_ptr<LodJob> lodJob;
+std::vector<ModelLod> modelLods;
+
+// A rotation draws the finest level with at most this many triangles per pixel of the square the model
+// may cover on screen, and the model itself again on release; 'L' turns the levels off
+const float LOD_TRIANGLES_PER_PIXEL{ 1.0f };
+bool rotationLods{ true };
+float modelDiagonal{ 0.0f };
+
+// Files with at least this many triangles are drawn while they load if progressiveLoading is on,
+// as a triangle soup until the welded mesh is ready
+const size_t STREAMING_MIN_TRIANGLES{ 1 << 22 };
+const size_t STREAMING_TRIANGLES_PER_FRAME{ 1 << 21 };
+
+bool progressiveLoading{ true };
+
+// A model too large to load lives in its chunk file. Every frame picks the chunks in view, largest on screen first,
+// until they hold OUT_OF_CORE_RESIDENT_TRIANGLES, and chunkStreamer reads those not on the GPU yet; chunks no longer
+// picked are evicted once their room is needed. The model's own vertex buffer holds a box for every chunk,
+// drawn in place of a chunk until it is uploaded.
+struct ResidentChunk
+{
+    unsigned int vertexArray{ 0 };
+    unsigned int vertexBuffer{ 0 };
+    uint64_t lastPicked{ 0 };
+};
+
+// About 1.1 GB of float positions
+const size_t OUT_OF_CORE_RESIDENT_TRIANGLES{ 1 << 25 };
+const size_t OUT_OF_CORE_TRIANGLES_PER_FRAME{ 1 << 21 };
+
+// A chunk covering fewer pixels across is not worth reading, its box shows as much
+const float MIN_CHUNK_PIXELS{ 2.0f };
+
+const int CHUNK_BOX_VERTICES{ 36 };
+
+std::unique_ptr<ChunkStreamer> chunkStreamer;
+std::vector<ResidentChunk> residentChunks;
+size_t residentTriangles{ 0 };
+uint64_t chunkPickFrame{ 0 };
+
+std::vector<uint32_t> chunksInView;
+std::vector<float> chunkPixels;
+std::vector<uint32_t> chunksToRead;
+std::vector<int> chunkBoxFirsts;
+std::vector<int> chunkBoxCounts;
+
+// Triangle order the next loads get, 'D' switches the overdraw pass
+IndexOrder indexOrder{ IndexOrder::VERTEX_CACHE_AND_OVERDRAW };
+
+// Vertex format the next loads get, 'Q' switches to 16-bit positions quantized across the model bounds
+VertexFormat vertexFormat{ VertexFormat::FLOAT };
+
+// Edges turning by more than this many degrees are creases for the next loads, "--crease-angle" sets it
+float creaseAngle{ 30.0f };
+
+// Only the boundaries and creases of a welded model are outlined, 'E' switches to every triangle edge
+bool featureEdgesOnly{ true };
+
+// On demand the loop sleeps until input, a load or a resize dirties the view instead of redrawing
+// every vsync; 'R' switches to continuous redraw
+bool renderOnDemand{ true };
+bool viewDirty{ true };
+
+// Frames stay this far apart while the view keeps changing, as during a drag
+const double MIN_FRAME_SECONDS{ 1.0 / 60.0 };
+
+// How often the loop wakes up while background work runs, to show its progress
+const double BACKGROUND_POLL_SECONDS{ 0.1 };
+
+// The model is drawn into a frame larger than the window by this fraction of it on every side. Pans and zooms
+// move that frame on screen, and the model is drawn again only once they settle or uncover the frame's edge
+const float MODEL_FRAME_MARGIN{ 0.25f };
+
+// A zoom settles this long after the last scroll, a pan when the right button is released
+const double ZOOM_SETTLE_SECONDS{ 0.3 };
+double lastScrollTime{ -1.0 };
+
+unsigned int modelFramebuffer{ 0 };
+unsigned int modelFrameTexture{ 0 };
+unsigned int modelFrameDepthBuffer{ 0 };
+int modelFrameWidth{ 0 };
+int modelFrameHeight{ 0 };
+
+// What the model frame was drawn with; it is dirty once anything but a pan or zoom changes the picture
+glm::mat4 modelFrameProj{ 1.0f };
+glm::mat4 modelFrameView{ 1.0f };
+bool modelFrameDirty{ true };
+
+// The frame on screen is a moved one, to be drawn again when the pan or zoom settles
+bool modelFrameMoved{ false };
+
+bool modelStreaming{ false };
+size_t modelTrianglesUploaded{ 0 };
+
+// Several files dropped at once, or the STL-files of a dropped directory, load as the parts of an assembly that share
+// the camera. Each part is drawn whole once it is loaded, culled by its bounds; parts get no levels of detail, clusters
+// or convex hull
+struct ModelPart
+{
+    std::string filepath;
+
+    // Where the part is in the pooled buffers; its indices count from its first vertex
+    size_t firstVertex{ 0 };
+    size_t firstIndex{ 0 };
+    size_t trianglesNumber{ 0 };
+    size_t firstEdgeIndex{ 0 };
+    int edgesIndicesNumber{ 0 };
+
+    StlBounds bounds{ 0, 0, 0, 0, 0, 0 };
+    glm::mat4 modelFromStored{ 1.0f };
+};
+
+std::vector<ModelPart> assemblyParts;
+
+// The parts of an assembly share pooled buffers, one after another in the order they loaded, all in the vertex format
+// of the drop; the buffers grow by doubling. Every part is placed instancesNumber times on a build plate, from one copy
+// of its geometry. partsData has an entry per instance, a part's instances in a row: 5 texels, the columns of the matrix
+// from the part's stored positions to model space, then its colour. instanceIndexBuffer holds 0, 1, 2, ... for an
+// instanced attribute, so a draw command's base instance picks the entry of its first instance
+struct PartsPool
+{
+    VertexFormat vertexFormat{ VertexFormat::FLOAT };
+
+    unsigned int vertexArray{ 0 };
+    unsigned int edgesVertexArray{ 0 };
+
+    unsigned int vertexBuffer{ 0 };
+    unsigned int elementBuffer{ 0 };
+    unsigned int edgesElementBuffer{ 0 };
+    unsigned int instanceIndexBuffer{ 0 };
+    size_t vertexBytes{ 0 };
+    size_t elementBytes{ 0 };
+    size_t edgesElementBytes{ 0 };
+
+    size_t verticesNumber{ 0 };
+    size_t indicesNumber{ 0 };
+    size_t edgesIndicesNumber{ 0 };
+
+    size_t instancesNumber{ 1 };
+    std::vector<float> partsData;
+    unsigned int partsDataBuffer{ 0 };
+    unsigned int partsDataTexture{ 0 };
+
+    // Model-space box of every instance, for culling and framing
+    std::vector<StlBounds> instanceBounds;
+
+    // DrawElementsIndirectCommand of the parts in view, written every frame: the triangles', then the edges'
+    std::vector<uint32_t> commands;
+    size_t triangleCommandsNumber{ 0 };
+    size_t edgeCommandsNumber{ 0 };
+    unsigned int commandsBuffer{ 0 };
+};
+
+PartsPool partsPool;
+
+// The whole assembly is drawn with one indirect multi-draw per pass where base instances and indirect multi-draw
+// are supported, otherwise with a draw per part in view
+bool partsMultiDrawIndirectSupported{ false };
+VertexFormat assemblyVertexFormat{ VertexFormat::FLOAT };
+
+// Instances of every part 'I' cycles through; a single model becomes a part of its own to be placed more than once
+const size_t PLATE_INSTANCES[]{ 1, 10, 100, 1000 };
+
+// Space between the instances on the plate, relative to the larger side of the assembly's footprint
+const float PLATE_GAP{ 0.1f };
+
+// A part still loading, with the buffers its job writes the welded mesh into once it waits for them
+struct PartLoad
+{
+    std::unique_ptr<LoadJob> job;
+    unsigned int vertexArray{ 0 };
+    unsigned int vertexBuffer{ 0 };
+    unsigned int elementBuffer{ 0 };
+};
+
+// Every part has its own job, PART_LOADS_AT_ONCE at a time, so one job's disk reads overlap another's parsing.
+// They share the hardware threads between them, so no more than that many soups and weld tables are held at once
+// and the machine is not oversubscribed.
+const unsigned int PART_LOADS_AT_ONCE{ 4 };
+
+std::vector<PartLoad> partLoads;
+std::deque<std::string> queuedPartPaths;
+size_t assemblyPartsNumber{ 0 };
+size_t assemblyPartsDone{ 0 };
+bool assemblyReplacesModel{ false };
+std::chrono::steady_clock::time_point assemblyLoadStart;
+double slowestPartSeconds{ 0 };
+
+unsigned int pendingVertexArray{ 0 };
+unsigned int pendingVertexBuffer{ 0 };
+unsigned int pendingElementBuffer{ 0 };
+
 static void GLClearError()
 {
     while (glGetError() != GL_NO_ERROR);
@@ -72,6 +354,7 @@ struct ShaderProgramSource
 {
     std::string VertexSource;
     std::string FragmentSource;
+    std::string GeometrySource;
 };
 
 static ShaderProgramSource ParseShader(const std::string& filepath)
@@ -80,13 +363,13 @@ static ShaderProgramSource ParseShader(const std::string& filepath)
 
     enum class ShaderType
     {
-        NONE = -1, VERTEX = 0, FRAGMENT = 1
+        NONE = -1, VERTEX = 0, FRAGMENT = 1, GEOMETRY = 2
     };
     ShaderType type = ShaderType::NONE;
 
     std::string line;
 
-    std::stringstream ss[2];
+    std::stringstream ss[3];
 
     while (getline(stream, line))
     {
@@ -96,6 +379,8 @@ static ShaderProgramSource ParseShader(const std::string& filepath)
                 type = ShaderType::VERTEX;
             else if (line.find("fragment") != std::string::npos)
                 type = ShaderType::FRAGMENT;
+            else if (line.find("geometry") != std::string::npos)
+                type = ShaderType::GEOMETRY;
         }
         else
         {
@@ -103,7 +388,7 @@ static ShaderProgramSource ParseShader(const std::string& filepath)
         }
     }
 
-    return { ss[0].str(), ss[1].str() };
+    return { ss[0].str(), ss[1].str(), ss[2].str() };
 }
 
 static unsigned int CompileShader(unsigned int type, const std::string& source)
@@ -122,7 +407,8 @@ static unsigned int CompileShader(unsigned int type, const std::string& source)
         glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
         char* message = (char*)alloca(length * sizeof(char));
         glGetShaderInfoLog(id, length, &length, message);
-        std::cout << "Failed to compile " << (type == GL_VERTEX_SHADER ? "vertex" : "fragment") << " shader!" << std::endl;
+        std::cout << "Failed to compile " << (type == GL_VERTEX_SHADER ? "vertex" : (type == GL_GEOMETRY_SHADER ? "geometry" : "fragment"))
+            << " shader!" << std::endl;
         std::cout << message << std::endl;
         glDeleteShader(id);
         return 0;
@@ -131,309 +417,1927 @@ static unsigned int CompileShader(unsigned int type, const std::string& source)
     return id;
 }
 
-static unsigned int CreateShader(const std::string& vertexShader)
+// The geometry stage is optional
+static unsigned int CreateShader(const std::string& vertexShader, const std::string& fragmentShader, const std::string& geometryShader = "")
 {
     unsigned int program = glCreateProgram();
     unsigned int vs = CompileShader(GL_VERTEX_SHADER, vertexShader);
+    unsigned int fs = CompileShader(GL_FRAGMENT_SHADER, fragmentShader);
+    unsigned int gs = geometryShader.empty() ? 0 : CompileShader(GL_GEOMETRY_SHADER, geometryShader);
 
     glAttachShader(program, vs);
-
-    const char* feedbackValues[1] = { "posXYZ" };
-    glTransformFeedbackVaryings(program, 1, feedbackValues, GL_INTERLEAVED_ATTRIBS);
+    glAttachShader(program, fs);
+    if (gs != 0)
+        glAttachShader(program, gs);
 
     glLinkProgram(program);
     glValidateProgram(program);
 
     glDeleteShader(vs);
+    glDeleteShader(fs);
+    if (gs != 0)
+        glDeleteShader(gs);
 
     return program;
 }
 
-static unsigned int CreateShader(const std::string& vertexShader, const std::string& fragmentShader)
+// A vertex stage alone, whose outputs named in varyings transform feedback captures interleaved
+static unsigned int CreateFeedbackShader(const std::string& vertexShader, const std::vector<const char*>& varyings)
 {
     unsigned int program = glCreateProgram();
     unsigned int vs = CompileShader(GL_VERTEX_SHADER, vertexShader);
-    unsigned int fs = CompileShader(GL_FRAGMENT_SHADER, fragmentShader);
 
-    glAttachShader(program, vs);
-    glAttachShader(program, fs);
+    glAttachShader(program, vs);
+
+    glTransformFeedbackVaryings(program, (int)varyings.size(), varyings.data(), GL_INTERLEAVED_ATTRIBS);
+
+    glLinkProgram(program);
+    glValidateProgram(program);
+
+    glDeleteShader(vs);
+
+    return program;
+}
+
+static void cursor_position_callback(GLFWwindow* window, double xpos, double ypos)
+{
+    currentMouseXpos = xpos;
+    currentMouseYpos = ypos;
+
+    if (middleMouseButtonPressed || rightMouseButtonPressed)
+        viewDirty = true;
+}
+
+static void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+    viewDirty = true;
+}
+
+static void window_refresh_callback(GLFWwindow* window)
+{
+    viewDirty = true;
+}
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (key == GLFW_KEY_O && action == GLFW_PRESS)
+    {
+        toDoOptimiseView = true;
+        viewDirty = true;
+    }
+
+    if (key == GLFW_KEY_P && action == GLFW_PRESS)
+    {
+        progressiveLoading = !progressiveLoading;
+        std::cout << "Progressive loading of large files " << (progressiveLoading ? "on" : "off") << std::endl;
+    }
+
+    if (key == GLFW_KEY_D && action == GLFW_PRESS)
+    {
+        bool overdraw = (indexOrder != IndexOrder::VERTEX_CACHE_AND_OVERDRAW);
+        indexOrder = overdraw ? IndexOrder::VERTEX_CACHE_AND_OVERDRAW : IndexOrder::VERTEX_CACHE;
+        std::cout << "Overdraw ordering of the next files loaded " << (overdraw ? "on" : "off") << std::endl;
+    }
+
+    if (key == GLFW_KEY_Q && action == GLFW_PRESS)
+    {
+        bool quantized = (vertexFormat != VertexFormat::QUANTIZED_16);
+        vertexFormat = quantized ? VertexFormat::QUANTIZED_16 : VertexFormat::FLOAT;
+        std::cout << "16-bit quantized positions for the next files loaded " << (quantized ? "on" : "off") << std::endl;
+    }
+
+    if (key == GLFW_KEY_E && action == GLFW_PRESS)
+    {
+        featureEdgesOnly = !featureEdgesOnly;
+        std::cout << "Edges drawn: " << (featureEdgesOnly ? "boundaries and creases" : "every triangle edge") << std::endl;
+        modelFrameDirty = true;
+        viewDirty = true;
+    }
+
+    if (key == GLFW_KEY_C && action == GLFW_PRESS)
+    {
+        if (clusterCulling == ClusterCulling::GPU)
+            clusterCulling = ClusterCulling::CPU;
+        else if (clusterCulling == ClusterCulling::CPU)
+            clusterCulling = ClusterCulling::NONE;
+        else
+            clusterCulling = gpuClusterCullingSupported ? ClusterCulling::GPU : ClusterCulling::CPU;
+
+        const char* places[3]{ "on the GPU", "on the CPU", "off" };
+        std::cout << "Culling of clusters outside the view " << places[(int)clusterCulling] << std::endl;
+        modelFrameDirty = true;
+        viewDirty = true;
+    }
+
+    if (key == GLFW_KEY_L && action == GLFW_PRESS)
+    {
+        rotationLods = !rotationLods;
+        std::cout << "Simplified levels of detail while rotating " << (rotationLods ? "on" : "off") << std::endl;
+    }
+
+    if (key == GLFW_KEY_I && action == GLFW_PRESS)
+    {
+        toDoPlaceInstances = true;
+        viewDirty = true;
+    }
+
+    if (key == GLFW_KEY_R && action == GLFW_PRESS)
+    {
+        renderOnDemand = !renderOnDemand;
+        std::cout << "Redraw " << (renderOnDemand ? "on demand" : "continuous") << std::endl;
+        viewDirty = true;
+    }
+}
+
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+    if (button == GLFW_MOUSE_BUTTON_MIDDLE)
+    {
+        if (action == GLFW_PRESS)
+        {
+            middleMouseButtonPressed = true;
+            mouseStartXpos = -1.0;
+            mouseStartYpos = -1.0;
+        }
+        else
+        {
+            middleMouseButtonPressed = false;
+            modelFrameDirty = true;
+            viewDirty = true;
+        }
+    }
+    else if (button == GLFW_MOUSE_BUTTON_RIGHT)
+    {
+        if (action == GLFW_PRESS)
+        {
+            rightMouseButtonPressed = true;
+            mouseStartXpos = -1.0;
+            mouseStartYpos = -1.0;
+        }
+        else
+        {
+            rightMouseButtonPressed = false;
+        }
+    }
+}
+
+void mouse_scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+    float sensitivity{ 0.1f };
+    mouseScroll += yoffset * sensitivity;
+    lastScrollTime = glfwGetTime();
+    viewDirty = true;
+}
+
+void Rotate3DModel(GLFWwindow* window)
+{
+    double xpos, ypos;
+    glfwGetCursorPos(window, &xpos, &ypos);
+
+    if ((mouseStartXpos < 0) or (mouseStartYpos < 0))
+    {
+        mouseStartXpos = xpos;
+        mouseStartYpos = ypos;
+        return;
+    }
+
+    float sensitivity{ 0.01f };
+
+    rotAngleX = (ypos - mouseStartYpos) * sensitivity;
+    rotAngleY = (xpos - mouseStartXpos) * sensitivity;
+
+    mouseStartXpos = xpos;
+    mouseStartYpos = ypos;
+}
+
+void Move3DModel(GLFWwindow* window)
+{
+    double xpos, ypos;
+    glfwGetCursorPos(window, &xpos, &ypos);
+
+    if ((mouseStartXpos < 0) or (mouseStartYpos < 0))
+    {
+        mouseStartXpos = xpos;
+        mouseStartYpos = ypos;
+        return;
+    }
+
+    moveDeltaX = xpos - mouseStartXpos;
+    moveDeltaY = mouseStartYpos - ypos;
+
+    mouseStartXpos = xpos;
+    mouseStartYpos = ypos;
+}
+
+// Sets an orthographic projection framing the view-space box [min, max]
+void FitProjection(float minX, float maxX, float minY, float maxY, float minZ, float maxZ, glm::mat4* proj)
+{
+    float largestDimension;
+    float centreX, centreY;
+
+    centreX = minX + (maxX - minX) / 2.0f;
+    centreY = minY + (maxY - minY) / 2.0f;
+
+    if ((maxX - minX) >= (maxY - minY))
+        largestDimension = maxX - minX;
+    else
+        largestDimension = maxY - minY;
+
+    minX = centreX - largestDimension / 2.0f;
+    maxX = centreX + largestDimension / 2.0f;
+
+    minY = centreY - largestDimension / 2.0f;
+    maxY = centreY + largestDimension / 2.0f;
+
+    *proj = glm::ortho(minX, maxX, minY, maxY, -minZ - 10.0f * largestDimension, -maxZ + 10.0f * largestDimension);
+    
+    glContextScaleX = (maxX - minX) / glContextWidth;
+    glContextScaleY = (maxY - minY) / glContextHeight;
+}
+
+// Two 1x1 float pixels the extents are blended into, and the pixel buffer they are read back through
+void CreateExtentsTarget()
+{
+    glGenRenderbuffers(2, extentsRenderbuffers);
+    glGenFramebuffers(1, &extentsFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, extentsFramebuffer);
+
+    for (int i = 0; i < 2; i++)
+    {
+        glBindRenderbuffer(GL_RENDERBUFFER, extentsRenderbuffers[i]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA32F, 1, 1);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_RENDERBUFFER, extentsRenderbuffers[i]);
+    }
+
+    unsigned int drawBuffers[2]{ GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+    ASSERT(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenBuffers(1, &extentsPixelBuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, extentsPixelBuffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, 2 * 4 * sizeof(float), nullptr, GL_STREAM_READ);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// Draws every vertex of the bound model as a point onto the extents pixels with the bound shader,
+// keeping the largest coordinates, and queues the read back; a newer request replaces a pending one
+void RequestViewExtents()
+{
+    if (extentsFence != nullptr)
+        glDeleteSync(extentsFence);
+
+    int viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, extentsFramebuffer);
+    glViewport(0, 0, 1, 1);
+
+    float lowest[4]{ -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    glClearBufferfv(GL_COLOR, 0, lowest);
+    glClearBufferfv(GL_COLOR, 1, lowest);
+
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_MAX);
+
+    glDrawArrays(GL_POINTS, 0, (int)modelVerticesNumber);
+
+    glBlendEquation(GL_FUNC_ADD);
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, extentsPixelBuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(0, 0, 1, 1, GL_RGBA, GL_FLOAT, (void*)0);
+    glReadBuffer(GL_COLOR_ATTACHMENT1);
+    glReadPixels(0, 0, 1, 1, GL_RGBA, GL_FLOAT, (void*)(4 * sizeof(float)));
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    extentsFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+// Fits the view to the requested extents once the GPU has them, without waiting otherwise
+void PollViewExtents(glm::mat4* proj)
+{
+    if (extentsFence == nullptr)
+        return;
+
+    if (glClientWaitSync(extentsFence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+        return;
+
+    glDeleteSync(extentsFence);
+    extentsFence = nullptr;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, extentsPixelBuffer);
+    const float* extents = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, 2 * 4 * sizeof(float), GL_MAP_READ_BIT);
+
+    if (extents != nullptr)
+    {
+        const float* maxCorner = extents;
+        const float* negatedMinCorner = extents + 4;
+
+        FitProjection(-negatedMinCorner[0], maxCorner[0], -negatedMinCorner[1], maxCorner[1], -negatedMinCorner[2], maxCorner[2], proj);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        modelFrameDirty = true;
+        viewDirty = true;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// Frames the convex hull as seen through view, which holds the extremes of the model along any direction
+void OptimiseViewForHull(const glm::mat4& view, const Mesh& hull, glm::mat4* proj)
+{
+    float minimum[3], maximum[3];
+    TransformedBounds(&view[0][0], hull.Component(0), hull.Component(1), hull.Component(2), hull.VerticesNumber(), minimum, maximum);
+
+    FitProjection(minimum[0], maximum[0], minimum[1], maximum[1], minimum[2], maximum[2], proj);
+}
+
+// Extends [minCorner, maxCorner] by the corners of a model-space box as seen through view
+void ExtendByBoxCorners(const glm::mat4& view, const StlBounds& bounds, glm::vec3& minCorner, glm::vec3& maxCorner)
+{
+    for (float x : { bounds.minX, bounds.maxX })
+        for (float y : { bounds.minY, bounds.maxY })
+            for (float z : { bounds.minZ, bounds.maxZ })
+            {
+                glm::vec3 corner = glm::vec3(view * glm::vec4(x, y, z, 1.0f));
+                minCorner = glm::min(minCorner, corner);
+                maxCorner = glm::max(maxCorner, corner);
+            }
+}
+
+// Frames the corners of a model-space box as seen through view, for when the vertices
+// cannot be scanned yet
+void OptimiseViewForBounds(const glm::mat4& view, const StlBounds& bounds, glm::mat4* proj)
+{
+    glm::vec3 minCorner(FLT_MAX), maxCorner(-FLT_MAX);
+    ExtendByBoxCorners(view, bounds, minCorner, maxCorner);
+
+    FitProjection(minCorner.x, maxCorner.x, minCorner.y, maxCorner.y, minCorner.z, maxCorner.z, proj);
+}
+
+// Frames the corners of the boxes of an assembly's part instances, each of which may be turned apart from the others
+void OptimiseViewForParts(const glm::mat4& view, const std::vector<StlBounds>& instanceBounds, glm::mat4* proj)
+{
+    glm::vec3 minCorner(FLT_MAX), maxCorner(-FLT_MAX);
+    for (const StlBounds& bounds : instanceBounds)
+        ExtendByBoxCorners(view, bounds, minCorner, maxCorner);
+
+    FitProjection(minCorner.x, maxCorner.x, minCorner.y, maxCorner.y, minCorner.z, maxCorner.z, proj);
+}
+
+// Colour texture and depth buffer of width x height pixels the model is drawn into, replacing the previous ones
+void CreateModelFrameTarget(int width, int height)
+{
+    if (modelFramebuffer == 0)
+    {
+        glGenFramebuffers(1, &modelFramebuffer);
+        glGenTextures(1, &modelFrameTexture);
+        glGenRenderbuffers(1, &modelFrameDepthBuffer);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, modelFrameTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, modelFrameDepthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, modelFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, modelFrameTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, modelFrameDepthBuffer);
+    ASSERT(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    modelFrameWidth = width;
+    modelFrameHeight = height;
+}
+
+// A zoom is under way until it settles, a pan while the right button is held
+bool PanningOrZooming()
+{
+    return rightMouseButtonPressed || (glfwGetTime() < lastScrollTime + ZOOM_SETTLE_SECONDS);
+}
+
+// Scale and offset taking the model frame's corners to where proj puts them in clip space. The projection is
+// orthographic and pans and zooms only translate and scale it, so x and y move independently
+void PlaceModelFrame(const glm::mat4& proj, glm::vec2* scale, glm::vec2* offset)
+{
+    glm::mat4 frameToClip = proj * glm::inverse(modelFrameProj);
+
+    *scale = glm::vec2(frameToClip[0][0], frameToClip[1][1]);
+    *offset = glm::vec2(frameToClip[3][0], frameToClip[3][1]);
+}
+
+// Whether the placed frame still covers the whole window
+bool ModelFrameCovers(const glm::vec2& scale, const glm::vec2& offset)
+{
+    for (int axis = 0; axis < 2; axis++)
+        if ((offset[axis] - std::abs(scale[axis]) > -1.0f) || (offset[axis] + std::abs(scale[axis]) < 1.0f))
+            return false;
+
+    return true;
+}
+
+void log(const std::string& string)
+{
+    std::cout << string << std::endl;
+}
+
+// Binds a buffer to a target no vertex array records and maps it for writing
+void* MapBufferForWriting(unsigned int buffer, size_t size)
+{
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    return glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+// Returns false if the contents got lost while mapped, e.g. on a display mode change
+bool UnmapBuffer(unsigned int buffer)
+{
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    return glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_TRUE;
+}
+
+void DeleteVertexBuffers(unsigned int& vertexArray, unsigned int& vertexBuffer, unsigned int& elementBuffer)
+{
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &elementBuffer);
+    glDeleteVertexArrays(1, &vertexArray);
+
+    vertexBuffer = 0;
+    elementBuffer = 0;
+    vertexArray = 0;
+}
+
+void DeletePendingBuffers()
+{
+    DeleteVertexBuffers(pendingVertexArray, pendingVertexBuffer, pendingElementBuffer);
+}
+
+// Unmaps and deletes buffers a cancelled job was writing into; the job must be gone already
+void DiscardPendingBuffers()
+{
+    if (pendingVertexBuffer == 0)
+        return;
+
+    UnmapBuffer(pendingVertexBuffer);
+    UnmapBuffer(pendingElementBuffer);
+
+    DeletePendingBuffers();
+}
+
+// Cancels the parts still loading or queued; the parts loaded so far stay
+void DiscardPartLoads()
+{
+    for (PartLoad& load : partLoads)
+    {
+        load.job.reset();
+
+        if (load.vertexBuffer != 0)
+        {
+            UnmapBuffer(load.vertexBuffer);
+            UnmapBuffer(load.elementBuffer);
+            DeleteVertexBuffers(load.vertexArray, load.vertexBuffer, load.elementBuffer);
+        }
+    }
+    partLoads.clear();
+    queuedPartPaths.clear();
+}
+
+static bool HasStlExtension(const std::filesystem::path& path)
+{
+    std::string extension = path.extension().u8string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+
+    return extension == ".stl";
+}
+
+// The dropped files, and the STL-files directly inside dropped directories in name order
+std::vector<std::string> DroppedFiles(int count, const char** paths)
+{
+    std::vector<std::string> filepaths;
+
+    for (int i = 0; i < count; i++)
+    {
+        std::filesystem::path path = std::filesystem::u8path(paths[i]);
+
+        std::error_code error;
+        if (!std::filesystem::is_directory(path, error))
+        {
+            filepaths.push_back(paths[i]);
+            continue;
+        }
+
+        std::vector<std::string> directoryFiles;
+        for (const auto& entry : std::filesystem::directory_iterator(path, error))
+        {
+            if (entry.is_regular_file(error) && HasStlExtension(entry.path()))
+                directoryFiles.push_back(entry.path().u8string());
+        }
+
+        std::sort(directoryFiles.begin(), directoryFiles.end());
+        filepaths.insert(filepaths.end(), directoryFiles.begin(), directoryFiles.end());
+    }
+
+    return filepaths;
+}
+
+void drop_callback(GLFWwindow* window, int count, const char** paths)
+{
+    // A new drop cancels the files still loading; the current model stays on screen meanwhile,
+    // unless it is the partly streamed one
+    loadJob.reset();
+    DiscardPendingBuffers();
+    DiscardPartLoads();
+
+    if (modelStreaming)
+    {
+        modelStreaming = false;
+        modelTrianglesNumber = 0;
+        modelFrameDirty = true;
+    }
+
+    std::vector<std::string> filepaths = DroppedFiles(count, paths);
+    if (filepaths.empty())
+    {
+        log("No STL-files dropped");
+        return;
+    }
+
+    loadPercentShown = -1;
+    viewDirty = true;
+
+    if (filepaths.size() == 1)
+    {
+        loadJob = std::make_unique<LoadJob>(filepaths[0], indexOrder, vertexFormat, creaseAngle, false, 0);
+        return;
+    }
+
+    // The parts are started by the next frame's poll
+    queuedPartPaths.assign(filepaths.begin(), filepaths.end());
+    assemblyPartsNumber = filepaths.size();
+    assemblyPartsDone = 0;
+    assemblyReplacesModel = true;
+    assemblyVertexFormat = vertexFormat;
+    assemblyLoadStart = std::chrono::steady_clock::now();
+    slowestPartSeconds = 0;
+}
+
+// Creates a vertex array reading positions in the given format from a new buffer for verticesNumber vertices and,
+// unless indicesNumber is 0, indices from a new element buffer; both are filled if data is given
+void CreateVertexBuffers(size_t verticesNumber, VertexFormat format, const void* vertices, size_t indicesNumber, const uint32_t* indices,
+    unsigned int& vertexArray, unsigned int& vertexBuffer, unsigned int& elementBuffer)
+{
+    glGenVertexArrays(1, &vertexArray);
+    glGenBuffers(1, &vertexBuffer);
+
+    glBindVertexArray(vertexArray);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, verticesNumber * VertexSize(format), vertices, GL_STATIC_DRAW);
+    if (format == VertexFormat::QUANTIZED_16)
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, (int)VertexSize(format), 0);
+    else
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, (int)VertexSize(format), 0);
+    glEnableVertexAttribArray(0);
+
+    elementBuffer = 0;
+    if (indicesNumber > 0)
+    {
+        glGenBuffers(1, &elementBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesNumber * sizeof(uint32_t), indices, GL_STATIC_DRAW);
+    }
+}
+
+void DeleteModelLods()
+{
+    for (ModelLod& lod : modelLods)
+    {
+        glDeleteBuffers(1, &lod.vertexBuffer);
+        glDeleteBuffers(1, &lod.elementBuffer);
+        glDeleteVertexArrays(1, &lod.vertexArray);
+        glDeleteBuffers(1, &lod.edgesElementBuffer);
+        glDeleteVertexArrays(1, &lod.edgesVertexArray);
+    }
+    modelLods.clear();
+}
+
+void DeleteAssemblyParts()
+{
+    glDeleteVertexArrays(1, &partsPool.vertexArray);
+    glDeleteVertexArrays(1, &partsPool.edgesVertexArray);
+    glDeleteBuffers(1, &partsPool.vertexBuffer);
+    glDeleteBuffers(1, &partsPool.elementBuffer);
+    glDeleteBuffers(1, &partsPool.edgesElementBuffer);
+    glDeleteBuffers(1, &partsPool.instanceIndexBuffer);
+    glDeleteBuffers(1, &partsPool.partsDataBuffer);
+    glDeleteTextures(1, &partsPool.partsDataTexture);
+    glDeleteBuffers(1, &partsPool.commandsBuffer);
+
+    partsPool = PartsPool();
+    assemblyParts.clear();
+}
+
+// Stops streaming the out-of-core model and frees its chunks on the GPU
+void DeleteOutOfCoreModel()
+{
+    chunkStreamer.reset();
+
+    for (ResidentChunk& resident : residentChunks)
+    {
+        glDeleteBuffers(1, &resident.vertexBuffer);
+        glDeleteVertexArrays(1, &resident.vertexArray);
+    }
+    residentChunks.clear();
+    residentTriangles = 0;
+    chunksInView.clear();
+}
+
+// Makes the given buffers the model's, replacing the previous ones along with the edges, clusters, levels of detail
+// and out-of-core chunks drawn from them
+void SwapModelBuffers(unsigned int vertexArray, unsigned int vertexBuffer, unsigned int elementBuffer)
+{
+    DeleteOutOfCoreModel();
+    DeleteAssemblyParts();
+
+    glDeleteBuffers(1, &modelVertexBuffer);
+    glDeleteBuffers(1, &modelElementBuffer);
+    glDeleteVertexArrays(1, &modelVertexArray);
+
+    glDeleteBuffers(1, &modelEdgesElementBuffer);
+    glDeleteVertexArrays(1, &modelEdgesVertexArray);
+    modelEdgesElementBuffer = 0;
+    modelEdgesVertexArray = 0;
+    modelEdgesIndicesNumber = 0;
+
+    DeleteModelLods();
+
+    modelClusters.clear();
+    glDeleteBuffers(1, &clustersVertexBuffer);
+    glDeleteBuffers(1, &clusterCommandsBuffer);
+    glDeleteVertexArrays(1, &clustersVertexArray);
+    clustersVertexBuffer = 0;
+    clusterCommandsBuffer = 0;
+    clustersVertexArray = 0;
+    clustersNumber = 0;
+
+    modelVertexArray = vertexArray;
+    modelVertexBuffer = vertexBuffer;
+    modelElementBuffer = elementBuffer;
+}
+
+// Uploads the feature edges as lines over the given vertex buffer, which must hold the welded vertices
+void CreateEdgeBuffers(const std::vector<uint32_t>& lines, VertexFormat format, unsigned int vertexBuffer,
+    unsigned int& edgesVertexArray, unsigned int& edgesElementBuffer, int& edgesIndicesNumber)
+{
+    if (lines.empty())
+        return;
+
+    glGenVertexArrays(1, &edgesVertexArray);
+    glGenBuffers(1, &edgesElementBuffer);
+
+    glBindVertexArray(edgesVertexArray);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    if (format == VertexFormat::QUANTIZED_16)
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, (int)VertexSize(format), 0);
+    else
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, (int)VertexSize(format), 0);
+    glEnableVertexAttribArray(0);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edgesElementBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, lines.size() * sizeof(uint32_t), lines.data(), GL_STATIC_DRAW);
+
+    edgesIndicesNumber = (int)lines.size();
+}
+
+// Uploads the model's clusters for culling on the GPU, along with room for a draw command for each
+void CreateClusterBuffers()
+{
+    if (!gpuClusterCullingSupported || modelClusters.empty())
+        return;
+
+    std::vector<ClusterNode> leaves = ClusterLeaves(modelClusters);
+
+    glGenVertexArrays(1, &clustersVertexArray);
+    glGenBuffers(1, &clustersVertexBuffer);
+    glGenBuffers(1, &clusterCommandsBuffer);
+
+    glBindVertexArray(clustersVertexArray);
+
+    glBindBuffer(GL_ARRAY_BUFFER, clustersVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, leaves.size() * sizeof(ClusterNode), leaves.data(), GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ClusterNode), (void*)offsetof(ClusterNode, min));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ClusterNode), (void*)offsetof(ClusterNode, max));
+    glEnableVertexAttribArray(1);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(ClusterNode), (void*)offsetof(ClusterNode, firstTriangle));
+    glEnableVertexAttribArray(2);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(ClusterNode), (void*)offsetof(ClusterNode, trianglesNumber));
+    glEnableVertexAttribArray(3);
+
+    // DrawElementsIndirectCommand: count, instanceCount, firstIndex, baseVertex, baseInstance
+    glBindBuffer(GL_ARRAY_BUFFER, clusterCommandsBuffer);
+    glBufferData(GL_ARRAY_BUFFER, leaves.size() * 5 * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+
+    clustersNumber = (int)leaves.size();
+}
+
+// Writes the draw commands of the clusters on the GPU; the culling program must be in use
+void WriteClusterCommands()
+{
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(clustersVertexArray);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, clusterCommandsBuffer);
+
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, clustersNumber);
+    glEndTransformFeedback();
+
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindVertexArray(modelVertexArray);
+    glDisable(GL_RASTERIZER_DISCARD);
+}
+
+void ReportLoad(const LoadedModel& model, std::chrono::steady_clock::time_point uploadStart)
+{
+    std::chrono::duration<double> uploadTime = std::chrono::steady_clock::now() - uploadStart;
+    double megabytes = model.fileSize / (1024.0 * 1024.0);
+
+    std::stringstream report;
+    report << "Loaded " << model.trianglesNumber << " triangles (" << megabytes << " MB) in " << model.parseSeconds * 1000.0 << " ms, ";
+    if (model.fromCache)
+        report << "from cache";
+    else
+        report << megabytes / model.parseSeconds << " MB/s";
+    report << ", uploaded in " << uploadTime.count() * 1000.0 << " ms, "
+        << model.verticesNumber << " vertices (" << (double)model.trianglesNumber * 3 / model.verticesNumber << " per unique)";
+    log(report.str());
+
+    if (!model.fromCache)
+    {
+        std::stringstream cacheReport;
+        cacheReport << "Vertex cache of " << VERTEX_CACHE_SIZE << ": ACMR " << model.cacheStatsBefore.acmr << " -> "
+            << model.cacheStatsAfter.acmr << ", ATVR " << model.cacheStatsBefore.atvr << " -> " << model.cacheStatsAfter.atvr;
+        log(cacheReport.str());
+    }
+
+    size_t featureEdgesNumber = model.featureEdges.lines.size() / 2;
+    std::stringstream edgesReport;
+    edgesReport << "Feature edges over " << creaseAngle << " degrees: " << featureEdgesNumber << " of " << model.featureEdges.meshEdgesNumber
+        << " (" << 100.0 * featureEdgesNumber / std::max<size_t>(1, model.featureEdges.meshEdgesNumber) << "%)";
+    log(edgesReport.str());
+}
+
+// Starts writing the cache of the parsed model from its welded mesh, replacing a job still writing the same file
+void StartCacheJob(LoadedModel& model, std::shared_ptr<const Mesh> mesh)
+{
+    std::string cachePath = StlCachePath(model.filepath);
+    cacheJobs.erase(std::remove_if(cacheJobs.begin(), cacheJobs.end(),
+        [&](const std::unique_ptr<CacheJob>& job) { return job->CachePath() == cachePath; }), cacheJobs.end());
+
+    cacheJobs.push_back(std::make_unique<CacheJob>(model, std::move(mesh)));
+}
+
+// Makes the loaded model current; it lives on the GPU, apart from its convex hull once that is computed.
+// The welded mesh, or the cache to decode it from, goes to the jobs computing the hull and, for a large model,
+// the levels of detail
+void AdoptModel(LoadedModel& model)
+{
+    modelTrianglesNumber = model.trianglesNumber;
+    modelVerticesNumber = model.verticesNumber;
+
+    model.soup = Mesh();
+
+    StlBounds& bounds = model.bounds;
+    bool buildLods = (model.trianglesNumber >= LOD_MIN_MODEL_TRIANGLES);
+
+    // A cached model has no welded mesh yet: the jobs decode it from the mapped cache, which they keep until then
+    std::shared_ptr<const StlCache> cache = std::move(model.cache);
+
+    // The cache is written from the indices too
+    if (!buildLods && !model.toCache)
+        model.mesh.ReleaseIndices();
+
+    std::shared_ptr<const Mesh> mesh = std::make_shared<Mesh>(std::move(model.mesh));
+
+    if (model.toCache)
+        StartCacheJob(model, mesh);
+
+    modelClusters = std::move(model.clusters);
+
+    modelHull = Mesh();
+    hullJob = cache ? std::make_unique<HullJob>(cache) : std::make_unique<HullJob>(mesh);
+
+    lodJob.reset();
+    if (buildLods)
+        lodJob = cache ? std::make_unique<LodJob>(cache, model.vertexFormat, bounds, creaseAngle) :
+            std::make_unique<LodJob>(mesh, model.vertexFormat, bounds, creaseAngle);
+
+    PositionTransform(model.vertexFormat, bounds, modelPositionScale, modelPositionOffset);
+    modelBounds = bounds;
+    modelVertexFormat = model.vertexFormat;
+
+    rotCentreX = bounds.minX + (bounds.maxX - bounds.minX) / 2.0f;
+    rotCentreY = bounds.minY + (bounds.maxY - bounds.minY) / 2.0f;
+    rotCentreZ = bounds.minZ + (bounds.maxZ - bounds.minZ) / 2.0f;
+
+    modelDiagonal = glm::length(glm::vec3(bounds.maxX - bounds.minX, bounds.maxY - bounds.minY, bounds.maxZ - bounds.minZ));
+
+    toDoOptimiseView = true;
+    modelFrameDirty = true;
+    viewDirty = true;
+}
+
+// Makes the loaded out-of-core model current, with the chunk boxes as its vertex buffer; its chunks are picked
+// and streamed in as it is drawn
+void AdoptOutOfCoreModel(LoadedModel& model, std::chrono::steady_clock::time_point uploadStart)
+{
+    const StlChunks& chunks = *model.chunks;
+
+    // 12 triangles per box, wound outwards
+    const int corners[CHUNK_BOX_VERTICES]
+    {
+        0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,  0, 1, 4, 1, 5, 4,
+        2, 6, 3, 3, 6, 7,  0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5
+    };
+
+    std::vector<float> boxes(chunks.ChunksNumber() * CHUNK_BOX_VERTICES * 3);
+    for (size_t chunk = 0; chunk < chunks.ChunksNumber(); chunk++)
+    {
+        const StlChunk& bounds = chunks.Chunks()[chunk];
+        float* vertex = boxes.data() + chunk * CHUNK_BOX_VERTICES * 3;
+
+        for (int corner : corners)
+        {
+            for (int axis = 0; axis < 3; axis++)
+                *vertex++ = (corner & (1 << axis)) ? bounds.max[axis] : bounds.min[axis];
+        }
+    }
+
+    unsigned int vertexArray, vertexBuffer, elementBuffer;
+    CreateVertexBuffers(boxes.size() / 3, VertexFormat::FLOAT, boxes.data(), 0, nullptr, vertexArray, vertexBuffer, elementBuffer);
+    SwapModelBuffers(vertexArray, vertexBuffer, elementBuffer);
+
+    modelStreaming = false;
+    modelTrianglesNumber = model.trianglesNumber;
+    modelVerticesNumber = 0;
+
+    residentChunks.assign(chunks.ChunksNumber(), ResidentChunk());
+    chunkPixels.assign(chunks.ChunksNumber(), 0.0f);
+    chunkStreamer = std::make_unique<ChunkStreamer>(std::move(model.chunks));
+
+    hullJob.reset();
+    modelHull = Mesh();
+    lodJob.reset();
+
+    StlBounds& bounds = model.bounds;
+    PositionTransform(VertexFormat::FLOAT, bounds, modelPositionScale, modelPositionOffset);
+
+    rotCentreX = bounds.minX + (bounds.maxX - bounds.minX) / 2.0f;
+    rotCentreY = bounds.minY + (bounds.maxY - bounds.minY) / 2.0f;
+    rotCentreZ = bounds.minZ + (bounds.maxZ - bounds.minZ) / 2.0f;
+
+    modelDiagonal = glm::length(glm::vec3(bounds.maxX - bounds.minX, bounds.maxY - bounds.minY, bounds.maxZ - bounds.minZ));
+
+    toDoOptimiseView = true;
+    modelFrameDirty = true;
+    viewDirty = true;
+
+    std::chrono::duration<double> uploadTime = std::chrono::steady_clock::now() - uploadStart;
+
+    std::stringstream report;
+    report << "Out of core: " << model.trianglesNumber << " triangles (" << model.fileSize / (1024.0 * 1024.0) << " MB) in "
+        << chunks.ChunksNumber() << " chunks, " << (model.fromCache ? "chunk file opened" : "split") << " in "
+        << model.parseSeconds * 1000.0 << " ms, boxes uploaded in " << uploadTime.count() * 1000.0 << " ms";
+    log(report.str());
+}
+
+// Pixels across the larger side of the screen rectangle a box covers, in a frame of the given size
+float BoxPixels(const float min[3], const float max[3], const glm::mat4& clipFromModel, int frameWidth, int frameHeight)
+{
+    glm::vec2 minCorner(FLT_MAX), maxCorner(-FLT_MAX);
+
+    for (float x : { min[0], max[0] })
+        for (float y : { min[1], max[1] })
+            for (float z : { min[2], max[2] })
+            {
+                glm::vec4 clip = clipFromModel * glm::vec4(x, y, z, 1.0f);
+                glm::vec2 corner = glm::vec2(clip) / clip.w;
+                minCorner = glm::min(minCorner, corner);
+                maxCorner = glm::max(maxCorner, corner);
+            }
+
+    return std::max((maxCorner.x - minCorner.x) * frameWidth, (maxCorner.y - minCorner.y) * frameHeight) / 2.0f;
+}
+
+// Finds the chunks in view and picks those to keep on the GPU, largest on screen first within the budget,
+// and has the streamer read the picked ones that are not there yet
+void PickChunks(const glm::mat4& clipFromModel, int frameWidth, int frameHeight)
+{
+    const StlChunks& chunks = chunkStreamer->Chunks();
+    chunkPickFrame++;
+
+    chunksInView.clear();
+    for (uint32_t chunk = 0; chunk < (uint32_t)chunks.ChunksNumber(); chunk++)
+    {
+        const StlChunk& bounds = chunks.Chunks()[chunk];
+        if (!BoxMayBeInView(bounds.min, bounds.max, &clipFromModel[0][0]))
+            continue;
+
+        chunkPixels[chunk] = BoxPixels(bounds.min, bounds.max, clipFromModel, frameWidth, frameHeight);
+        chunksInView.push_back(chunk);
+    }
+
+    std::sort(chunksInView.begin(), chunksInView.end(), [](uint32_t a, uint32_t b) { return chunkPixels[a] > chunkPixels[b]; });
+
+    chunksToRead.clear();
+    size_t pickedTriangles = 0;
+    for (uint32_t chunk : chunksInView)
+    {
+        size_t trianglesNumber = (size_t)chunks.Chunks()[chunk].trianglesNumber;
+        if ((chunkPixels[chunk] < MIN_CHUNK_PIXELS) || (pickedTriangles + trianglesNumber > OUT_OF_CORE_RESIDENT_TRIANGLES))
+            continue;
+
+        pickedTriangles += trianglesNumber;
+        residentChunks[chunk].lastPicked = chunkPickFrame;
+
+        if (residentChunks[chunk].vertexArray == 0)
+            chunksToRead.push_back(chunk);
+    }
+
+    chunkStreamer->Want(chunksToRead);
+}
+
+// Uploads up to trianglesBudget triangles of the chunks read since the last frame that are still picked, evicting
+// the chunks picked the longest ago to make room
+void UploadReadChunks(size_t trianglesBudget)
+{
+    const StlChunks& chunks = chunkStreamer->Chunks();
+
+    size_t trianglesUploaded = 0;
+    ReadChunk read;
+    while ((trianglesUploaded < trianglesBudget) && chunkStreamer->TakeRead(read))
+    {
+        ResidentChunk& resident = residentChunks[read.chunk];
+        size_t trianglesNumber = (size_t)chunks.Chunks()[read.chunk].trianglesNumber;
+
+        if ((resident.lastPicked != chunkPickFrame) || (resident.vertexArray != 0))
+            continue;
+
+        while (residentTriangles + trianglesNumber > OUT_OF_CORE_RESIDENT_TRIANGLES)
+        {
+            auto evicted = std::min_element(residentChunks.begin(), residentChunks.end(), [](const ResidentChunk& a, const ResidentChunk& b)
+            {
+                return (a.vertexArray != 0) && ((b.vertexArray == 0) || (a.lastPicked < b.lastPicked));
+            });
+
+            if ((evicted->vertexArray == 0) || (evicted->lastPicked == chunkPickFrame))
+                break;
+
+            glDeleteBuffers(1, &evicted->vertexBuffer);
+            glDeleteVertexArrays(1, &evicted->vertexArray);
+            evicted->vertexBuffer = 0;
+            evicted->vertexArray = 0;
+            residentTriangles -= (size_t)chunks.Chunks()[evicted - residentChunks.begin()].trianglesNumber;
+        }
+
+        if (residentTriangles + trianglesNumber > OUT_OF_CORE_RESIDENT_TRIANGLES)
+            continue;
+
+        unsigned int elementBuffer;
+        CreateVertexBuffers(trianglesNumber * 3, VertexFormat::FLOAT, read.positions.data(), 0, nullptr, resident.vertexArray,
+            resident.vertexBuffer, elementBuffer);
+
+        residentTriangles += trianglesNumber;
+        trianglesUploaded += trianglesNumber;
+    }
+
+    glBindVertexArray(modelVertexArray);
+}
+
+// Chunks read in the background are uploaded at the next frame
+void PollChunkStreamer()
+{
+    if (chunkStreamer && chunkStreamer->HasRead())
+    {
+        modelFrameDirty = true;
+        viewDirty = true;
+    }
+}
+
+// The job writes the welded mesh straight into mapped buffers, so it goes to GPU memory without a CPU copy
+void MapJobBuffers(LoadJob& job, unsigned int& vertexArray, unsigned int& vertexBuffer, unsigned int& elementBuffer)
+{
+    size_t verticesNumber = job.VerticesNumber();
+    size_t indicesNumber = job.TrianglesNumber() * 3;
+
+    VertexFormat format = job.VerticesFormat();
+    CreateVertexBuffers(verticesNumber, format, nullptr, indicesNumber, nullptr, vertexArray, vertexBuffer, elementBuffer);
+
+    void* vertices = MapBufferForWriting(vertexBuffer, verticesNumber * VertexSize(format));
+    void* indices = MapBufferForWriting(elementBuffer, indicesNumber * sizeof(uint32_t));
+
+    if ((vertices == nullptr) || (indices == nullptr))
+    {
+        log("Failed to map vertex buffers for " + job.Filepath());
+        job.Cancel();
+        return;
+    }
+
+    job.SetDestination(vertices, static_cast<uint32_t*>(indices));
+}
+
+void MapPendingBuffers()
+{
+    MapJobBuffers(*loadJob, pendingVertexArray, pendingVertexBuffer, pendingElementBuffer);
+}
+
+bool UploadModel(LoadedModel& model)
+{
+    auto uploadStart = std::chrono::steady_clock::now();
+
+    if (model.chunks)
+    {
+        AdoptOutOfCoreModel(model, uploadStart);
+        return true;
+    }
+
+    if (model.fromCache)
+    {
+        // A cached model goes from the mapped cache file to the GPU as it is
+        unsigned int vertexArray, vertexBuffer, elementBuffer;
+        CreateVertexBuffers(model.verticesNumber, model.vertexFormat, model.cache->Vertices(), model.trianglesNumber * 3, model.cache->Indices(),
+            vertexArray, vertexBuffer, elementBuffer);
+        SwapModelBuffers(vertexArray, vertexBuffer, elementBuffer);
+    }
+    else
+    {
+        bool verticesIntact = UnmapBuffer(pendingVertexBuffer);
+        bool indicesIntact = UnmapBuffer(pendingElementBuffer);
+
+        if (!verticesIntact || !indicesIntact)
+        {
+            DeletePendingBuffers();
+            return false;
+        }
+
+        SwapModelBuffers(pendingVertexArray, pendingVertexBuffer, pendingElementBuffer);
+        pendingVertexBuffer = 0;
+        pendingElementBuffer = 0;
+        pendingVertexArray = 0;
+    }
+
+    modelStreaming = false;
+    CreateEdgeBuffers(model.featureEdges.lines, model.vertexFormat, modelVertexBuffer, modelEdgesVertexArray, modelEdgesElementBuffer,
+        modelEdgesIndicesNumber);
+    AdoptModel(model);
+    CreateClusterBuffers();
+
+    ReportLoad(model, uploadStart);
+    return true;
+}
+
+// Large models are shown while they load: the soup buffer is sized from the triangle count up front
+// and every frame uploads what the job has parsed since the previous one
+void StartStreaming(glm::mat4& view, glm::mat4* proj)
+{
+    unsigned int vertexArray, vertexBuffer, elementBuffer;
+    CreateVertexBuffers(loadJob->TrianglesNumber() * 3, VertexFormat::FLOAT, nullptr, 0, nullptr, vertexArray, vertexBuffer, elementBuffer);
+    SwapModelBuffers(vertexArray, vertexBuffer, elementBuffer);
+    PositionTransform(VertexFormat::FLOAT, loadJob->ParsedBounds(), modelPositionScale, modelPositionOffset);
+
+    hullJob.reset();
+    modelHull = Mesh();
+    lodJob.reset();
+
+    modelStreaming = true;
+    modelTrianglesUploaded = 0;
+    modelTrianglesNumber = 0;
+    modelVerticesNumber = 0;
+
+    // Frame the first batch so there is something to look at, the exact fit follows the welded mesh
+    StlBounds bounds = loadJob->ParsedBounds();
+
+    rotCentreX = bounds.minX + (bounds.maxX - bounds.minX) / 2.0f;
+    rotCentreY = bounds.minY + (bounds.maxY - bounds.minY) / 2.0f;
+    rotCentreZ = bounds.minZ + (bounds.maxZ - bounds.minZ) / 2.0f;
+
+    OptimiseViewForBounds(view, bounds, proj);
+    modelFrameDirty = true;
+    viewDirty = true;
+}
+
+void UploadStreamedTriangles(size_t trianglesBudget)
+{
+    size_t trianglesParsed = std::min(loadJob->TrianglesParsed(), modelTrianglesUploaded + trianglesBudget);
+    if (trianglesParsed <= modelTrianglesUploaded)
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, modelVertexBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER,
+        modelTrianglesUploaded * 3 * 3 * sizeof(float),
+        (trianglesParsed - modelTrianglesUploaded) * 3 * 3 * sizeof(float),
+        loadJob->Positions() + modelTrianglesUploaded * 3 * 3);
+
+    modelTrianglesUploaded = trianglesParsed;
+    modelTrianglesNumber = modelTrianglesUploaded;
+    modelFrameDirty = true;
+    viewDirty = true;
+}
+
+// Called once per frame, so a finished model is swapped in at a frame boundary
+void PollLoadJob(GLFWwindow* window, glm::mat4& view, glm::mat4* proj)
+{
+    if (!loadJob)
+        return;
+
+    std::string filepath = loadJob->Filepath();
+    std::string filename = filepath.substr(filepath.find_last_of("/\\") + 1);
+
+    switch (loadJob->State())
+    {
+    case LoadState::RUNNING:
+    {
+        int percent = (int)(loadJob->Progress() * 100.0f);
+        if (percent != loadPercentShown)
+        {
+            std::string title = std::string(WINDOW_TITLE) + " - loading " + filename + " (" + std::to_string(percent) + "%)";
+            glfwSetWindowTitle(window, title.c_str());
+            loadPercentShown = percent;
+        }
+
+        if (loadJob->WaitsForDestination())
+        {
+            if (pendingVertexBuffer == 0)
+                MapPendingBuffers();
+        }
+        else if (!modelStreaming && progressiveLoading && (loadJob->TrianglesNumber() >= STREAMING_MIN_TRIANGLES) &&
+            (loadJob->TrianglesParsed() > 0))
+        {
+            StartStreaming(view, proj);
+        }
+
+        if (modelStreaming)
+            UploadStreamedTriangles(STREAMING_TRIANGLES_PER_FRAME);
+
+        return;
+    }
+    case LoadState::SUCCEEDED:
+        if (!UploadModel(loadJob->Result()))
+        {
+            log("Lost the mapped vertex buffers while loading " + filepath);
+            glfwSetWindowTitle(window, WINDOW_TITLE);
+            break;
+        }
+        glfwSetWindowTitle(window, (std::string(WINDOW_TITLE) + " - " + filename).c_str());
+        break;
+    case LoadState::FAILED:
+        log(loadJob->Error());
+        glfwSetWindowTitle(window, WINDOW_TITLE);
+        break;
+    case LoadState::CANCELLED:
+        break;
+    }
+
+    loadJob.reset();
+    DiscardPendingBuffers();
+    loadPercentShown = -1;
+}
+
+// Makes buffer, a pooled buffer of capacity bytes of which the first usedBytes are in use, hold at least neededBytes;
+// a grown buffer is a new one, with the bytes in use copied over on the GPU
+void ReservePoolBuffer(unsigned int& buffer, size_t& capacity, size_t usedBytes, size_t neededBytes)
+{
+    if (neededBytes <= capacity)
+        return;
+
+    size_t grownCapacity = std::max(neededBytes, 2 * capacity);
+
+    unsigned int grownBuffer;
+    glGenBuffers(1, &grownBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grownBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, grownCapacity, nullptr, GL_STATIC_DRAW);
+
+    if (usedBytes > 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+    }
+
+    glDeleteBuffers(1, &buffer);
+    buffer = grownBuffer;
+    capacity = grownCapacity;
+}
+
+// Points the pool's vertex arrays at its buffers, which may have grown into new ones
+void BindPartsVertexArrays()
+{
+    int vertexSize = (int)VertexSize(partsPool.vertexFormat);
+
+    for (unsigned int vertexArray : { partsPool.vertexArray, partsPool.edgesVertexArray })
+    {
+        glBindVertexArray(vertexArray);
+
+        glBindBuffer(GL_ARRAY_BUFFER, partsPool.vertexBuffer);
+        if (partsPool.vertexFormat == VertexFormat::QUANTIZED_16)
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, vertexSize, 0);
+        else
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertexSize, 0);
+        glEnableVertexAttribArray(0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, partsPool.instanceIndexBuffer);
+        glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 0, 0);
+        glVertexAttribDivisor(1, 1);
+        glEnableVertexAttribArray(1);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (vertexArray == partsPool.vertexArray) ? partsPool.elementBuffer : partsPool.edgesElementBuffer);
+    }
+
+    glBindVertexArray(modelVertexArray);
+}
+
+// Tells the parts apart by hue, the first one about the blue of a single model
+void PartColor(size_t part, float color[4])
+{
+    // Steps of the golden ratio spread the hues of any number of parts evenly
+    float hue = fmodf(0.62f + 0.618034f * part, 1.0f) * 6.0f;
+    float saturation = 0.75f;
+    float value = 0.8f;
+
+    // HSV to RGB, red, green and blue peaking 120 degrees apart
+    const float channelPhases[3]{ 5.0f, 3.0f, 1.0f };
+    for (int channel = 0; channel < 3; channel++)
+    {
+        float k = fmodf(channelPhases[channel] + hue, 6.0f);
+        color[channel] = value - value * saturation * std::max(0.0f, std::min({ k, 4.0f - k, 1.0f }));
+    }
+    color[3] = 1.0f;
+}
+
+// Creates the pool's vertex arrays, draw commands and parts' data, to which the buffers of the parts are added
+void CreatePartsPool(VertexFormat format)
+{
+    partsPool.vertexFormat = format;
+    glGenVertexArrays(1, &partsPool.vertexArray);
+    glGenVertexArrays(1, &partsPool.edgesVertexArray);
+    glGenBuffers(1, &partsPool.instanceIndexBuffer);
+    glGenBuffers(1, &partsPool.commandsBuffer);
+
+    glGenBuffers(1, &partsPool.partsDataBuffer);
+    glGenTextures(1, &partsPool.partsDataTexture);
+    glBindBuffer(GL_TEXTURE_BUFFER, partsPool.partsDataBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, partsPool.partsDataTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, partsPool.partsDataBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// The matrix form of positionScale and positionOffset
+glm::mat4 ModelFromStored(VertexFormat format, const StlBounds& bounds)
+{
+    float positionScale[3], positionOffset[3];
+    PositionTransform(format, bounds, positionScale, positionOffset);
+
+    glm::mat4 modelFromStored = glm::translate(glm::mat4(1.0f), glm::vec3(positionOffset[0], positionOffset[1], positionOffset[2]));
+    return glm::scale(modelFromStored, glm::vec3(positionScale[0], positionScale[1], positionScale[2]));
+}
+
+// Appends a loaded part to the pooled buffers: a cached part from its mapped cache file, a parsed one by a copy on
+// the GPU from the buffers its job wrote
+void AppendPart(PartLoad& load, ModelPart& part)
+{
+    LoadedModel& model = load.job->Result();
+
+    if (partsPool.vertexArray == 0)
+        CreatePartsPool(model.vertexFormat);
+
+    size_t vertexSize = VertexSize(partsPool.vertexFormat);
+
+    part.firstVertex = partsPool.verticesNumber;
+    part.firstIndex = partsPool.indicesNumber;
+    part.firstEdgeIndex = partsPool.edgesIndicesNumber;
+
+    size_t vertexOffset = part.firstVertex * vertexSize;
+    size_t vertexBytes = model.verticesNumber * vertexSize;
+    size_t indexOffset = part.firstIndex * sizeof(uint32_t);
+    size_t indexBytes = model.trianglesNumber * 3 * sizeof(uint32_t);
+
+    ReservePoolBuffer(partsPool.vertexBuffer, partsPool.vertexBytes, vertexOffset, vertexOffset + vertexBytes);
+    ReservePoolBuffer(partsPool.elementBuffer, partsPool.elementBytes, indexOffset, indexOffset + indexBytes);
+
+    if (model.fromCache)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, partsPool.vertexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, vertexOffset, vertexBytes, model.cache->Vertices());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, partsPool.elementBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexBytes, model.cache->Indices());
+    }
+    else
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, load.vertexBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, partsPool.vertexBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, vertexOffset, vertexBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, load.elementBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, partsPool.elementBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, indexOffset, indexBytes);
+    }
+
+    const std::vector<uint32_t>& lines = model.featureEdges.lines;
+    if (!lines.empty())
+    {
+        size_t edgesOffset = part.firstEdgeIndex * sizeof(uint32_t);
+        size_t edgesBytes = lines.size() * sizeof(uint32_t);
+        ReservePoolBuffer(partsPool.edgesElementBuffer, partsPool.edgesElementBytes, edgesOffset, edgesOffset + edgesBytes);
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, partsPool.edgesElementBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, edgesOffset, edgesBytes, lines.data());
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    part.trianglesNumber = model.trianglesNumber;
+    part.edgesIndicesNumber = (int)lines.size();
+    partsPool.verticesNumber += model.verticesNumber;
+    partsPool.indicesNumber += model.trianglesNumber * 3;
+    partsPool.edgesIndicesNumber += lines.size();
+
+    part.modelFromStored = ModelFromStored(model.vertexFormat, model.bounds);
+
+    BindPartsVertexArrays();
+}
+
+// Where instance of instancesNumber copies of the assembly within bounds goes on the plate: row by row in a square
+// grid on the XY-plane, each turned by a quarter more about the Z-axis through the centre of the assembly
+glm::mat4 PlateInstanceTransform(size_t instance, size_t instancesNumber, const StlBounds& bounds)
+{
+    if (instancesNumber == 1)
+        return glm::mat4(1.0f);
+
+    size_t columns = (size_t)std::ceil(std::sqrt((double)instancesNumber));
+    float pitch = std::max(bounds.maxX - bounds.minX, bounds.maxY - bounds.minY) * (1.0f + PLATE_GAP);
+    glm::vec3 centre(bounds.minX + (bounds.maxX - bounds.minX) / 2.0f, bounds.minY + (bounds.maxY - bounds.minY) / 2.0f, 0.0f);
+
+    glm::mat4 transform = glm::translate(glm::mat4(1.0f), centre + glm::vec3(pitch * (instance % columns), pitch * (instance / columns), 0.0f));
+    transform = glm::rotate(transform, glm::radians(90.0f * (instance % 4)), glm::vec3(0.0f, 0.0f, 1.0f));
+    return glm::translate(transform, -centre);
+}
+
+// Writes the entries of every instance of every part into partsData and their boxes, and frames and centres the view
+// on them
+void PlaceParts()
+{
+    size_t instancesNumber = partsPool.instancesNumber;
+    size_t entriesNumber = assemblyParts.size() * instancesNumber;
+
+    StlBounds assemblyBounds = EmptyBounds();
+    for (const ModelPart& part : assemblyParts)
+        MergeBounds(assemblyBounds, part.bounds);
+
+    std::vector<glm::mat4> instanceTransforms(instancesNumber);
+    for (size_t instance = 0; instance < instancesNumber; instance++)
+        instanceTransforms[instance] = PlateInstanceTransform(instance, instancesNumber, assemblyBounds);
+
+    partsPool.partsData.clear();
+    partsPool.instanceBounds.clear();
+    StlBounds plateBounds = EmptyBounds();
+
+    for (size_t i = 0; i < assemblyParts.size(); i++)
+    {
+        const ModelPart& part = assemblyParts[i];
+
+        float color[4];
+        PartColor(i, color);
+
+        for (const glm::mat4& instanceTransform : instanceTransforms)
+        {
+            glm::mat4 modelFromStored = instanceTransform * part.modelFromStored;
+            partsPool.partsData.insert(partsPool.partsData.end(), &modelFromStored[0][0], &modelFromStored[0][0] + 16);
+            partsPool.partsData.insert(partsPool.partsData.end(), color, color + 4);
+
+            glm::vec3 minCorner(FLT_MAX), maxCorner(-FLT_MAX);
+            ExtendByBoxCorners(instanceTransform, part.bounds, minCorner, maxCorner);
+
+            StlBounds bounds{ minCorner.x, maxCorner.x, minCorner.y, maxCorner.y, minCorner.z, maxCorner.z };
+            partsPool.instanceBounds.push_back(bounds);
+            MergeBounds(plateBounds, bounds);
+        }
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, partsPool.partsDataBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, partsPool.partsData.size() * sizeof(float), partsPool.partsData.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    std::vector<float> instanceIndices(entriesNumber);
+    for (size_t entry = 0; entry < entriesNumber; entry++)
+        instanceIndices[entry] = (float)entry;
+
+    glBindBuffer(GL_ARRAY_BUFFER, partsPool.instanceIndexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, entriesNumber * sizeof(float), instanceIndices.data(), GL_STATIC_DRAW);
+
+    // The camera turns around the centre of the plate and frames it
+    rotCentreX = plateBounds.minX + (plateBounds.maxX - plateBounds.minX) / 2.0f;
+    rotCentreY = plateBounds.minY + (plateBounds.maxY - plateBounds.minY) / 2.0f;
+    rotCentreZ = plateBounds.minZ + (plateBounds.maxZ - plateBounds.minZ) / 2.0f;
+
+    toDoOptimiseView = true;
+    modelFrameDirty = true;
+    viewDirty = true;
+}
+
+// Adds a loaded part to the assembly, replacing the previous model with the first one
+bool AdoptPart(PartLoad& load)
+{
+    LoadedModel& model = load.job->Result();
+
+    if (model.chunks)
+    {
+        log("Too large for a part of an assembly: " + model.filepath);
+        return false;
+    }
+
+    if (!model.fromCache)
+    {
+        bool verticesIntact = UnmapBuffer(load.vertexBuffer);
+        bool indicesIntact = UnmapBuffer(load.elementBuffer);
+
+        if (!verticesIntact || !indicesIntact)
+        {
+            DeleteVertexBuffers(load.vertexArray, load.vertexBuffer, load.elementBuffer);
+            log("Lost the mapped vertex buffers while loading " + model.filepath);
+            return false;
+        }
+    }
+
+    if (assemblyReplacesModel)
+    {
+        // Swapping in no model buffers takes away the previous model or assembly, along with its jobs
+        SwapModelBuffers(0, 0, 0);
+        hullJob.reset();
+        modelHull = Mesh();
+        lodJob.reset();
+
+        modelStreaming = false;
+        modelTrianglesNumber = 0;
+        modelVerticesNumber = 0;
+        assemblyReplacesModel = false;
+    }
+
+    ModelPart part;
+    part.filepath = model.filepath;
+    part.bounds = model.bounds;
+    AppendPart(load, part);
 
-    glLinkProgram(program);
-    glValidateProgram(program);
+    // The buffers the job wrote were copied into the pool
+    if (load.vertexBuffer != 0)
+        DeleteVertexBuffers(load.vertexArray, load.vertexBuffer, load.elementBuffer);
 
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+    assemblyParts.push_back(part);
+    modelTrianglesNumber += part.trianglesNumber;
 
-    return program;
+    PlaceParts();
+    return true;
 }
 
-static void cursor_position_callback(GLFWwindow* window, double xpos, double ypos)
+// Hands the buffers of the loaded model over to the parts pool as its only part, so it can be placed more than once
+// without a copy of its geometry; it loses its levels of detail, clusters and hull. Returns false if there is no
+// welded model to hand over.
+bool PoolModel()
 {
-    currentMouseXpos = xpos;
-    currentMouseYpos = ypos;
+    if (!assemblyParts.empty())
+        return true;
+
+    if ((modelElementBuffer == 0) || chunkStreamer)
+        return false;
+
+    ModelPart part;
+    part.trianglesNumber = modelTrianglesNumber;
+    part.edgesIndicesNumber = modelEdgesIndicesNumber;
+    part.bounds = modelBounds;
+    part.modelFromStored = ModelFromStored(modelVertexFormat, modelBounds);
+
+    unsigned int vertexBuffer = modelVertexBuffer;
+    unsigned int elementBuffer = modelElementBuffer;
+    unsigned int edgesElementBuffer = modelEdgesElementBuffer;
+    size_t verticesNumber = modelVerticesNumber;
+    modelVertexBuffer = 0;
+    modelElementBuffer = 0;
+    modelEdgesElementBuffer = 0;
+
+    SwapModelBuffers(0, 0, 0);
+    hullJob.reset();
+    modelHull = Mesh();
+    lodJob.reset();
+    modelVerticesNumber = 0;
+
+    CreatePartsPool(modelVertexFormat);
+    partsPool.vertexBuffer = vertexBuffer;
+    partsPool.elementBuffer = elementBuffer;
+    partsPool.edgesElementBuffer = edgesElementBuffer;
+    partsPool.vertexBytes = verticesNumber * VertexSize(modelVertexFormat);
+    partsPool.elementBytes = part.trianglesNumber * 3 * sizeof(uint32_t);
+    partsPool.edgesElementBytes = part.edgesIndicesNumber * sizeof(uint32_t);
+    partsPool.verticesNumber = verticesNumber;
+    partsPool.indicesNumber = part.trianglesNumber * 3;
+    partsPool.edgesIndicesNumber = part.edgesIndicesNumber;
+    BindPartsVertexArrays();
+
+    assemblyParts.push_back(part);
+    return true;
 }
 
-void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+// Places every part of the assembly, or the model, the next number of times in PLATE_INSTANCES on the plate
+void CycleInstances()
 {
-    if (key == GLFW_KEY_O && action == GLFW_PRESS)
-        toDoOptimiseView = true;
+    size_t instancesNumber = assemblyParts.empty() ? 1 : partsPool.instancesNumber;
+
+    const size_t* current = std::find(std::begin(PLATE_INSTANCES), std::end(PLATE_INSTANCES), instancesNumber);
+    instancesNumber = ((current == std::end(PLATE_INSTANCES)) || (current + 1 == std::end(PLATE_INSTANCES))) ? PLATE_INSTANCES[0] : *(current + 1);
+
+    if (!PoolModel())
+    {
+        log("No loaded model to place more than once");
+        return;
+    }
+
+    partsPool.instancesNumber = instancesNumber;
+    PlaceParts();
+
+    std::stringstream report;
+    report << instancesNumber << " instances of " << assemblyParts.size() << " part(s) on the plate: " << modelTrianglesNumber * instancesNumber
+        << " triangles drawn from " << modelTrianglesNumber << " in memory";
+    log(report.str());
 }
 
-void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+// Called once per frame: starts queued parts as jobs finish and adopts the loaded ones at a frame boundary
+void PollPartLoads(GLFWwindow* window)
 {
-    if (button == GLFW_MOUSE_BUTTON_MIDDLE)
+    if (partLoads.empty() && queuedPartPaths.empty())
+        return;
+
+    for (size_t i = 0; i < partLoads.size();)
     {
-        if (action == GLFW_PRESS)
-        {
-            middleMouseButtonPressed = true;
-            mouseStartXpos = -1.0;
-            mouseStartYpos = -1.0;
-        }
-        else
+        PartLoad& load = partLoads[i];
+        LoadState state = load.job->State();
+
+        if (state == LoadState::RUNNING)
         {
-            middleMouseButtonPressed = false;
+            if (load.job->WaitsForDestination() && (load.vertexBuffer == 0))
+                MapJobBuffers(*load.job, load.vertexArray, load.vertexBuffer, load.elementBuffer);
+            i++;
+            continue;
         }
-    }
-    else if (button == GLFW_MOUSE_BUTTON_RIGHT)
-    {
-        if (action == GLFW_PRESS)
+
+        if (state == LoadState::SUCCEEDED)
         {
-            rightMouseButtonPressed = true;
-            mouseStartXpos = -1.0;
-            mouseStartYpos = -1.0;
+            if (AdoptPart(load))
+                slowestPartSeconds = std::max(slowestPartSeconds, load.job->Result().parseSeconds);
         }
-        else
+        else if (state == LoadState::FAILED)
         {
-            rightMouseButtonPressed = false;
+            log(load.job->Error());
         }
-    }
-}
 
-void mouse_scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
-{
-    float sensitivity{ 0.1f };
-    mouseScroll += yoffset * sensitivity;
-}
+        load.job.reset();
+        if (load.vertexBuffer != 0)
+            DeleteVertexBuffers(load.vertexArray, load.vertexBuffer, load.elementBuffer);
 
-void Rotate3DModel(GLFWwindow* window)
-{
-    double xpos, ypos;
-    glfwGetCursorPos(window, &xpos, &ypos);
+        partLoads.erase(partLoads.begin() + i);
+        assemblyPartsDone++;
+    }
 
-    if ((mouseStartXpos < 0) or (mouseStartYpos < 0))
+    unsigned int workersPerLoad = std::max(1u, HardwareThreads() / PART_LOADS_AT_ONCE);
+    while ((partLoads.size() < PART_LOADS_AT_ONCE) && !queuedPartPaths.empty())
     {
-        mouseStartXpos = xpos;
-        mouseStartYpos = ypos;
+        PartLoad load;
+        load.job = std::make_unique<LoadJob>(queuedPartPaths.front(), indexOrder, assemblyVertexFormat, creaseAngle, true, workersPerLoad);
+        partLoads.push_back(std::move(load));
+        queuedPartPaths.pop_front();
+    }
+
+    if (!partLoads.empty())
+    {
+        int percent = (int)(100 * assemblyPartsDone / assemblyPartsNumber);
+        if (percent != loadPercentShown)
+        {
+            std::string title = std::string(WINDOW_TITLE) + " - loading " + std::to_string(assemblyPartsNumber) + " parts (" +
+                std::to_string(percent) + "%)";
+            glfwSetWindowTitle(window, title.c_str());
+            loadPercentShown = percent;
+        }
         return;
     }
 
-    float sensitivity{ 0.01f };
+    std::chrono::duration<double> loadTime = std::chrono::steady_clock::now() - assemblyLoadStart;
 
-    rotAngleX = (ypos - mouseStartYpos) * sensitivity;
-    rotAngleY = (xpos - mouseStartXpos) * sensitivity;
+    std::stringstream report;
+    report << "Loaded an assembly of " << assemblyParts.size() << " of " << assemblyPartsNumber << " parts, " << modelTrianglesNumber
+        << " triangles, in " << loadTime.count() * 1000.0 << " ms; the slowest part took " << slowestPartSeconds * 1000.0 << " ms";
+    log(report.str());
 
-    mouseStartXpos = xpos;
-    mouseStartYpos = ypos;
+    std::string title = std::string(WINDOW_TITLE) + " - " + std::to_string(assemblyParts.size()) + " parts";
+    glfwSetWindowTitle(window, title.c_str());
+    loadPercentShown = -1;
 }
 
-void Move3DModel(GLFWwindow* window)
+void PollCacheJobs()
 {
-    double xpos, ypos;
-    glfwGetCursorPos(window, &xpos, &ypos);
-
-    if ((mouseStartXpos < 0) or (mouseStartYpos < 0))
+    for (size_t i = 0; i < cacheJobs.size();)
     {
-        mouseStartXpos = xpos;
-        mouseStartYpos = ypos;
-        return;
-    }
+        if (!cacheJobs[i]->Done())
+        {
+            i++;
+            continue;
+        }
 
-    moveDeltaX = xpos - mouseStartXpos;
-    moveDeltaY = mouseStartYpos - ypos;
+        if (!cacheJobs[i]->Written())
+            log("Failed to write " + cacheJobs[i]->CachePath());
 
-    mouseStartXpos = xpos;
-    mouseStartYpos = ypos;
+        cacheJobs.erase(cacheJobs.begin() + i);
+    }
 }
 
-void OptimiseView(glm::mat4& view, glm::mat4* proj)
+void PollHullJob()
 {
-    float minX, maxX, minY, maxY, minZ, maxZ;
-    float largestDimension;
-    float centreX, centreY;
+    if (!hullJob || !hullJob->Done())
+        return;
 
-    int triangleCount{ 0 };
+    modelHull = std::move(hullJob->Hull());
 
-    glm::vec3 vertexPosition;
+    std::stringstream report;
+    report << "Convex hull of " << hullJob->VerticesNumber() << " vertices: " << modelHull.VerticesNumber() << " on it, in "
+        << hullJob->Seconds() * 1000.0 << " ms";
+    log(report.str());
 
-    if (modelTrianglesNumber < 1)
-    {
-        minX = maxX = minY = maxY = minZ = maxZ = 0;
-    }
-    else
-    {
-        vertexPosition = { modelPositions[0], modelPositions[1], modelPositions[2] };
+    hullJob.reset();
+}
 
-        minX = maxX = vertexPosition.x;
-        minY = maxY = vertexPosition.y;
-        minZ = maxZ = vertexPosition.z;
-    }
+// Uploads the levels of detail once they are built
+void PollLodJob()
+{
+    if (!lodJob || !lodJob->Done())
+        return;
 
-    while (triangleCount < modelTrianglesNumber)
-    {
-        for (int initialPosition : {0, 3, 6})
-        {
-            vertexPosition = {
-                modelPositions[triangleCount * 3 * 3 + initialPosition],
-                modelPositions[triangleCount * 3 * 3 + initialPosition + 1],
-                modelPositions[triangleCount * 3 * 3 + initialPosition + 2]
-            };
+    std::stringstream report;
+    report << "Levels of detail:";
 
-            if (vertexPosition.x < minX) minX = vertexPosition.x;
-            if (vertexPosition.x > maxX) maxX = vertexPosition.x;
+    for (LodLevel& level : lodJob->Levels())
+    {
+        ModelLod lod;
+        CreateVertexBuffers(level.mesh.VerticesNumber(), lodJob->VerticesFormat(), level.vertices.data(), level.mesh.IndicesNumber(),
+            level.mesh.Indices(), lod.vertexArray, lod.vertexBuffer, lod.elementBuffer);
+        lod.trianglesNumber = (int)level.mesh.TrianglesNumber();
 
-            if (vertexPosition.y < minY) minY = vertexPosition.y;
-            if (vertexPosition.y > maxY) maxY = vertexPosition.y;
+        CreateEdgeBuffers(level.featureEdges.lines, lodJob->VerticesFormat(), lod.vertexBuffer, lod.edgesVertexArray, lod.edgesElementBuffer,
+            lod.edgesIndicesNumber);
 
-            if (vertexPosition.z < minZ) minZ = vertexPosition.z;
-            if (vertexPosition.z > maxZ) maxZ = vertexPosition.z;
-        }
-        triangleCount++;
+        modelLods.push_back(lod);
+        report << " " << lod.trianglesNumber;
     }
 
-    centreX = minX + (maxX - minX) / 2.0f;
-    centreY = minY + (maxY - minY) / 2.0f;
-
-    if ((maxX - minX) >= (maxY - minY))
-        largestDimension = maxX - minX;
-    else
-        largestDimension = maxY - minY;
-
-    minX = centreX - largestDimension / 2.0f;
-    maxX = centreX + largestDimension / 2.0f;
-
-    minY = centreY - largestDimension / 2.0f;
-    maxY = centreY + largestDimension / 2.0f;
+    report << " triangles, in " << lodJob->Seconds() * 1000.0 << " ms";
+    log(report.str());
 
-    *proj = glm::ortho(minX, maxX, minY, maxY, -minZ - 10.0f * largestDimension, -maxZ + 10.0f * largestDimension);
-    
-    glContextScaleX = (maxX - minX) / glContextWidth;
-    glContextScaleY = (maxY - minY) / glContextHeight;
+    lodJob.reset();
 }
 
-void log(const std::string& string)
+// The finest level of detail with at most LOD_TRIANGLES_PER_PIXEL for the square the model may cover on screen,
+// or the coarsest; none if the model itself has few enough triangles
+const ModelLod* ChooseRotationLod()
 {
-    std::cout << string << std::endl;
-}
+    if (!rotationLods || modelLods.empty())
+        return nullptr;
 
-void drop_callback(GLFWwindow* window, int count, const char** paths)
-{
-    std::ifstream stream(paths[0], std::ios::binary);
+    double pixels = (double)(modelDiagonal / glContextScaleX) * (modelDiagonal / glContextScaleY);
+    double trianglesBudget = pixels * LOD_TRIANGLES_PER_PIXEL;
+
+    if (modelTrianglesNumber <= trianglesBudget)
+        return nullptr;
 
-    char header[80];
-    stream.read(header, 80);
+    for (const ModelLod& lod : modelLods)
+        if (lod.trianglesNumber <= trianglesBudget)
+            return &lod;
 
-    int tempTrianglesNumber;
-    stream.read((char*)&tempTrianglesNumber, 4);
+    return &modelLods.back();
+}
 
-    if ((tempTrianglesNumber < 1) || (tempTrianglesNumber > 1E8))
+// Continuous redraw polls and leaves the pace to vsync. On demand the loop waits for events, waking up
+// regularly while a load or a view fit runs and when a zoom settles, and draws no two frames closer than MIN_FRAME_SECONDS
+void WaitForEvents(double lastFrameTime)
+{
+    if (!renderOnDemand)
     {
+        glfwPollEvents();
         return;
     }
 
-    modelTrianglesNumber = tempTrianglesNumber;
+    for (double now = glfwGetTime(); now < lastFrameTime + MIN_FRAME_SECONDS; now = glfwGetTime())
+        glfwWaitEventsTimeout(lastFrameTime + MIN_FRAME_SECONDS - now);
 
-    struct triangle
-    {
-        float normalVector[3];
-        float vertex1[3];
-        float vertex2[3];
-        float vertex3[3];
+    if (viewDirty)
+        glfwPollEvents();
+    else if (modelFrameMoved && !rightMouseButtonPressed)
+        glfwWaitEventsTimeout(std::max(lastScrollTime + ZOOM_SETTLE_SECONDS - glfwGetTime(), MIN_FRAME_SECONDS));
+    else if (loadJob || !partLoads.empty() || (extentsFence != nullptr))
+        glfwWaitEventsTimeout(BACKGROUND_POLL_SECONDS);
+    else
+        glfwWaitEvents();
+}
 
-        short int attributeByteCount;
-    };
+// Draws the chunks of the out-of-core model in view, those not on the GPU as their boxes
+void DrawChunks()
+{
+    const StlChunks& chunks = chunkStreamer->Chunks();
 
-    modelPositionsLength = modelTrianglesNumber * 3 * 3;
+    chunkBoxFirsts.clear();
+    chunkBoxCounts.clear();
+    for (uint32_t chunk : chunksInView)
+    {
+        const ResidentChunk& resident = residentChunks[chunk];
+        if (resident.vertexArray != 0)
+        {
+            glBindVertexArray(resident.vertexArray);
+            glDrawArrays(GL_TRIANGLES, 0, (int)(chunks.Chunks()[chunk].trianglesNumber * 3));
+        }
+        else
+        {
+            chunkBoxFirsts.push_back((int)chunk * CHUNK_BOX_VERTICES);
+            chunkBoxCounts.push_back(CHUNK_BOX_VERTICES);
+        }
+    }
 
-    delete[] modelPositions;
+    glBindVertexArray(modelVertexArray);
+    if (!chunkBoxFirsts.empty())
+        glMultiDrawArrays(GL_TRIANGLES, chunkBoxFirsts.data(), chunkBoxCounts.data(), (int)chunkBoxFirsts.size());
+}
 
-    modelPositions = new float[modelPositionsLength];
+// Draws the given level of detail, or the model itself, indexed unless it is still streamed in as a triangle soup
+// or out of core. Of the model only the clusters culling picked are drawn
+void DrawModel(const ModelLod* lod)
+{
+    if (lod != nullptr)
+    {
+        glDrawElements(GL_TRIANGLES, lod->trianglesNumber * 3, GL_UNSIGNED_INT, 0);
+    }
+    else if (chunkStreamer)
+    {
+        DrawChunks();
+    }
+    else if ((modelElementBuffer != 0) && (clusterCulling == ClusterCulling::GPU) && (clusterCommandsBuffer != 0))
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, clusterCommandsBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, clustersNumber, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    else if ((modelElementBuffer != 0) && (clusterCulling == ClusterCulling::CPU) && !modelClusters.empty())
+    {
+        visibleCounts.clear();
+        visibleOffsets.clear();
+        for (const TriangleRange& range : visibleRanges)
+        {
+            visibleCounts.push_back((int)range.number * 3);
+            visibleOffsets.push_back((const void*)((size_t)range.first * 3 * sizeof(uint32_t)));
+        }
 
-    float minX, maxX, minY, maxY, minZ, maxZ;
+        if (!visibleRanges.empty())
+            glMultiDrawElements(GL_TRIANGLES, visibleCounts.data(), GL_UNSIGNED_INT, visibleOffsets.data(), (int)visibleRanges.size());
+    }
+    else if (modelElementBuffer != 0)
+    {
+        glDrawElements(GL_TRIANGLES, (int)(modelTrianglesNumber * 3), GL_UNSIGNED_INT, 0);
+    }
+    else
+    {
+        glDrawArrays(GL_TRIANGLES, 0, (int)(modelTrianglesNumber * 3));
+    }
+}
 
-    minX = maxX = minY = maxY = minZ = maxZ = 0;
+// Writes the draw commands of the assembly's part instances inside the view, unless culling is off, for their triangles
+// and their feature edges, and uploads them for indirect multi-draw. A part's instances in view one after another
+// share a command.
+void CullParts(const glm::mat4& clipFromModel)
+{
+    std::vector<uint32_t>& commands = partsPool.commands;
+    commands.clear();
 
-    int triangleCount{ 0 };
-    triangle triangleBuf;
-    int positionsArrayIndex{ 0 };
-    float coordinate;
+    // First instance and number of instances of each run in view, by part
+    std::vector<uint32_t> runs;
+    std::vector<size_t> partRuns(assemblyParts.size() + 1, 0);
 
-    while ((triangleCount < modelTrianglesNumber) && (stream.read((char*)&triangleBuf, 50)))
+    size_t instancesNumber = partsPool.instancesNumber;
+    for (size_t i = 0; i < assemblyParts.size(); i++)
     {
-        if (triangleCount == 0)
+        partRuns[i] = runs.size();
+        for (size_t instance = 0; instance < instancesNumber; instance++)
         {
-            minX = maxX = triangleBuf.vertex1[0];
-            minY = maxY = triangleBuf.vertex1[1];
-            minZ = maxZ = triangleBuf.vertex1[2];
+            size_t entry = i * instancesNumber + instance;
+            const StlBounds& bounds = partsPool.instanceBounds[entry];
+            float min[3]{ bounds.minX, bounds.minY, bounds.minZ };
+            float max[3]{ bounds.maxX, bounds.maxY, bounds.maxZ };
+
+            if ((clusterCulling != ClusterCulling::NONE) && !BoxMayBeInView(min, max, &clipFromModel[0][0]))
+                continue;
+
+            if ((runs.size() > partRuns[i]) && (runs[runs.size() - 2] + runs.back() == entry))
+                runs.back()++;
+            else
+                runs.insert(runs.end(), { (uint32_t)entry, 1 });
         }
+    }
+    partRuns.back() = runs.size();
 
-        for (int i = 0; i < 9; i++)
+    // DrawElementsIndirectCommand: count, instanceCount, firstIndex, baseVertex, baseInstance
+    for (int edges = 0; edges < 2; edges++)
+    {
+        for (size_t i = 0; i < assemblyParts.size(); i++)
         {
-            coordinate = *(triangleBuf.vertex1 + i);
+            const ModelPart& part = assemblyParts[i];
+            uint32_t count = edges ? (uint32_t)part.edgesIndicesNumber : (uint32_t)(part.trianglesNumber * 3);
+            uint32_t firstIndex = edges ? (uint32_t)part.firstEdgeIndex : (uint32_t)part.firstIndex;
 
-            if ((i == 0) || (i == 3) || (i == 6))
-            {
-                if (coordinate < minX) minX = coordinate;
-                if (coordinate > maxX) maxX = coordinate;
-            }
-            else if ((i == 1) || (i == 4) || (i == 7))
-            {
-                if (coordinate < minY) minY = coordinate;
-                if (coordinate > maxY) maxY = coordinate;
-            }
-            else
-            {
-                if (coordinate < minZ) minZ = coordinate;
-                if (coordinate > maxZ) maxZ = coordinate;
-            }
+            if (count == 0)
+                continue;
 
-            modelPositions[positionsArrayIndex++] = coordinate;
+            for (size_t run = partRuns[i]; run < partRuns[i + 1]; run += 2)
+                commands.insert(commands.end(), { count, runs[run + 1], firstIndex, (uint32_t)part.firstVertex, runs[run] });
         }
 
-        triangleCount++;
+        if (!edges)
+            partsPool.triangleCommandsNumber = commands.size() / 5;
     }
+    partsPool.edgeCommandsNumber = commands.size() / 5 - partsPool.triangleCommandsNumber;
 
-    rotCentreX = minX + (maxX - minX) / 2.0f;
-    rotCentreY = minY + (maxY - minY) / 2.0f;
-    rotCentreZ = minZ + (maxZ - minZ) / 2.0f;
-
-    glDeleteBuffers(1, &modelVertexBuffer);
-    glDeleteBuffers(1, &modelTransformFeedback);
-    glDeleteVertexArrays(1, &modelVertexArray);
-
-    glFlush();
-    glFinish();
+    if (partsMultiDrawIndirectSupported)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, partsPool.commandsBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(uint32_t), commands.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+}
 
-    glGenVertexArrays(1, &modelVertexArray);
-    glGenBuffers(1, &modelVertexBuffer);
-    glGenBuffers(1, &modelTransformFeedback);
+// Draws the part instances of the assembly in view, or their feature edges, with the bound program, which reads
+// their transforms and colours from partsData
+void DrawParts(bool edges)
+{
+    size_t firstCommand = edges ? partsPool.triangleCommandsNumber : 0;
+    size_t commandsNumber = edges ? partsPool.edgeCommandsNumber : partsPool.triangleCommandsNumber;
+    GLenum mode = edges ? GL_LINES : GL_TRIANGLES;
 
-    glBindVertexArray(modelVertexArray);
+    if (commandsNumber == 0)
+        return;
 
-    glBindBuffer(GL_ARRAY_BUFFER, modelVertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, modelPositionsLength * sizeof(float), modelPositions, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
-    glEnableVertexAttribArray(0);
+    glBindVertexArray(edges ? partsPool.edgesVertexArray : partsPool.vertexArray);
 
-    glBindBuffer(GL_ARRAY_BUFFER, modelTransformFeedback);
-    glBufferData(GL_ARRAY_BUFFER, modelPositionsLength * sizeof(float), nullptr, GL_STATIC_READ);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, partsPool.partsDataTexture);
+    glActiveTexture(GL_TEXTURE0);
 
-    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, modelTransformFeedback);
+    if (partsMultiDrawIndirectSupported)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, partsPool.commandsBuffer);
+        glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, (const void*)(firstCommand * 5 * sizeof(uint32_t)), (int)commandsNumber, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    else
+    {
+        // Without base instances the instance index attribute starts at each command's first instance instead
+        glBindBuffer(GL_ARRAY_BUFFER, partsPool.instanceIndexBuffer);
+        for (size_t i = firstCommand; i < firstCommand + commandsNumber; i++)
+        {
+            const uint32_t* command = &partsPool.commands[i * 5];
+            glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 0, (const void*)(command[4] * sizeof(float)));
+            glDrawElementsInstancedBaseVertex(mode, (int)command[0], GL_UNSIGNED_INT, (const void*)(command[2] * sizeof(uint32_t)),
+                (int)command[1], (int)command[3]);
+        }
+    }
 
-    toDoOptimiseView = true;
+    glBindVertexArray(modelVertexArray);
 }
 
-int main(void)
+int main(int argc, char** argv)
 {
+    // "--bench [files]" times the point kernels instead of opening the viewer
+    if ((argc > 1) && (std::string(argv[1]) == "--bench"))
+        return RunBenchmark(std::vector<std::string>(argv + 2, argv + argc));
+
+    for (int arg = 1; arg + 1 < argc; arg++)
+        if (std::string(argv[arg]) == "--crease-angle")
+            creaseAngle = (float)atof(argv[arg + 1]);
+
     GLFWwindow* window;
 
     /* Initialize the library */
@@ -457,7 +2361,7 @@ int main(void)
     glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
     /* Create a windowed mode window and its OpenGL context */
-    window = glfwCreateWindow(glContextWidth, glContextHeight, "STL Viewer", NULL, NULL);
+    window = glfwCreateWindow(glContextWidth, glContextHeight, WINDOW_TITLE, NULL, NULL);
     if (!window)
     {
         glfwTerminate();
@@ -482,10 +2386,18 @@ int main(void)
 
     glfwSwapInterval(1);
 
+    // Culling on the GPU writes draw commands that only indirect multi-draw takes
+    gpuClusterCullingSupported = GLEW_ARB_draw_indirect && GLEW_ARB_multi_draw_indirect;
+    if (gpuClusterCullingSupported)
+        clusterCulling = ClusterCulling::GPU;
+
+    // The parts' draw commands pick their transforms and colours by base instance
+    partsMultiDrawIndirectSupported = gpuClusterCullingSupported && GLEW_ARB_base_instance;
+
     glfwSetDropCallback(window, drop_callback);
     
     ShaderProgramSource sourceModelDraw = ParseShader("res/shaders/ModelDraw.shader");
-    unsigned int shaderModelDraw = CreateShader(sourceModelDraw.VertexSource, sourceModelDraw.FragmentSource);
+    unsigned int shaderModelDraw = CreateShader(sourceModelDraw.VertexSource, sourceModelDraw.FragmentSource, sourceModelDraw.GeometrySource);
     glUseProgram(shaderModelDraw);
 
     int locationProjAtModelDraw = glGetUniformLocation(shaderModelDraw, "proj");
@@ -497,16 +2409,93 @@ int main(void)
     int locationColor = glGetUniformLocation(shaderModelDraw, "inColor");
     ASSERT(locationColor != -1);
 
+    int locationEdgesColor = glGetUniformLocation(shaderModelDraw, "edgesColor");
+    ASSERT(locationEdgesColor != -1);
+
+    int locationViewportSize = glGetUniformLocation(shaderModelDraw, "viewportSize");
+    ASSERT(locationViewportSize != -1);
+
+    int locationPositionScaleAtModelDraw = glGetUniformLocation(shaderModelDraw, "positionScale");
+    ASSERT(locationPositionScaleAtModelDraw != -1);
+
+    int locationPositionOffsetAtModelDraw = glGetUniformLocation(shaderModelDraw, "positionOffset");
+    ASSERT(locationPositionOffsetAtModelDraw != -1);
+
+    int locationFromPartsAtModelDraw = glGetUniformLocation(shaderModelDraw, "fromParts");
+    ASSERT(locationFromPartsAtModelDraw != -1);
+
+    // The parts' data is on texture unit 1
+    int locationPartsDataAtModelDraw = glGetUniformLocation(shaderModelDraw, "partsData");
+    ASSERT(locationPartsDataAtModelDraw != -1);
+    glUniform1i(locationPartsDataAtModelDraw, 1);
+
+    ShaderProgramSource sourcePlainDraw = ParseShader("res/shaders/PlainDraw.shader");
+    unsigned int shaderPlainDraw = CreateShader(sourcePlainDraw.VertexSource, sourcePlainDraw.FragmentSource);
+    glUseProgram(shaderPlainDraw);
+
+    int locationProjAtPlainDraw = glGetUniformLocation(shaderPlainDraw, "proj");
+    ASSERT(locationProjAtPlainDraw != -1);
+
+    int locationViewAtPlainDraw = glGetUniformLocation(shaderPlainDraw, "view");
+    ASSERT(locationViewAtPlainDraw != -1);
+
+    int locationColorAtPlainDraw = glGetUniformLocation(shaderPlainDraw, "inColor");
+    ASSERT(locationColorAtPlainDraw != -1);
+
+    int locationPositionScaleAtPlainDraw = glGetUniformLocation(shaderPlainDraw, "positionScale");
+    ASSERT(locationPositionScaleAtPlainDraw != -1);
+
+    int locationPositionOffsetAtPlainDraw = glGetUniformLocation(shaderPlainDraw, "positionOffset");
+    ASSERT(locationPositionOffsetAtPlainDraw != -1);
+
+    int locationFromPartsAtPlainDraw = glGetUniformLocation(shaderPlainDraw, "fromParts");
+    ASSERT(locationFromPartsAtPlainDraw != -1);
+
+    int locationPartColorsAtPlainDraw = glGetUniformLocation(shaderPlainDraw, "partColors");
+    ASSERT(locationPartColorsAtPlainDraw != -1);
+
+    int locationPartsDataAtPlainDraw = glGetUniformLocation(shaderPlainDraw, "partsData");
+    ASSERT(locationPartsDataAtPlainDraw != -1);
+    glUniform1i(locationPartsDataAtPlainDraw, 1);
+
     float modelColor[4] = { 0.2f, 0.3f, 0.8f, 1.0f };
     float edgesColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
 
-    ShaderProgramSource sourceTransformFeedback = ParseShader("res/shaders/TransformFeedback.shader");
-    unsigned int shaderTransformFeedback = CreateShader(sourceTransformFeedback.VertexSource);
-    glUseProgram(shaderTransformFeedback);
+    ShaderProgramSource sourceViewExtents = ParseShader("res/shaders/ViewExtents.shader");
+    unsigned int shaderViewExtents = CreateShader(sourceViewExtents.VertexSource, sourceViewExtents.FragmentSource);
+    glUseProgram(shaderViewExtents);
+
+    int locationViewAtViewExtents = glGetUniformLocation(shaderViewExtents, "view");
+    ASSERT(locationViewAtViewExtents != -1);
+
+    int locationPositionScaleAtViewExtents = glGetUniformLocation(shaderViewExtents, "positionScale");
+    ASSERT(locationPositionScaleAtViewExtents != -1);
+
+    int locationPositionOffsetAtViewExtents = glGetUniformLocation(shaderViewExtents, "positionOffset");
+    ASSERT(locationPositionOffsetAtViewExtents != -1);
 
-    int locationViewAtTransformFeedback = glGetUniformLocation(shaderTransformFeedback, "view");
-    ASSERT(locationViewAtTransformFeedback != -1);
+    CreateExtentsTarget();
+
+    ShaderProgramSource sourceFrameDraw = ParseShader("res/shaders/FrameDraw.shader");
+    unsigned int shaderFrameDraw = CreateShader(sourceFrameDraw.VertexSource, sourceFrameDraw.FragmentSource);
+    glUseProgram(shaderFrameDraw);
+
+    glUniform1i(glGetUniformLocation(shaderFrameDraw, "frameImage"), 0);
+
+    int locationFrameScale = glGetUniformLocation(shaderFrameDraw, "frameScale");
+    ASSERT(locationFrameScale != -1);
+
+    int locationFrameOffset = glGetUniformLocation(shaderFrameDraw, "frameOffset");
+    ASSERT(locationFrameOffset != -1);
     
+    ShaderProgramSource sourceClusterCull = ParseShader("res/shaders/ClusterCull.shader");
+    unsigned int shaderClusterCull = CreateFeedbackShader(sourceClusterCull.VertexSource,
+        { "count", "instanceCount", "firstIndex", "baseVertex", "baseInstance" });
+    glUseProgram(shaderClusterCull);
+
+    int locationClipFromModelAtClusterCull = glGetUniformLocation(shaderClusterCull, "clipFromModel");
+    ASSERT(locationClipFromModelAtClusterCull != -1);
+
     ShaderProgramSource sourceTextDraw = ParseShader("res/shaders/TextDraw.shader");
     unsigned int shaderTextDraw = CreateShader(sourceTextDraw.VertexSource, sourceTextDraw.FragmentSource);
     glUseProgram(shaderTextDraw);
@@ -526,6 +2515,8 @@ int main(void)
     glfwSetMouseButtonCallback(window, mouse_button_callback);
     glfwSetScrollCallback(window, mouse_scroll_callback);
     glfwSetCursorPosCallback(window, cursor_position_callback);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
 
     glEnable(GL_DEPTH_TEST);
     
@@ -593,9 +2584,31 @@ int main(void)
     }
     stbi_image_free(data);
 
+    double lastFrameTime{ 0 };
+
     /* Loop until the user closes the window */
     while (!glfwWindowShouldClose(window))
     {
+        PollLoadJob(window, view, &proj);
+        PollPartLoads(window);
+        PollCacheJobs();
+        PollHullJob();
+        PollLodJob();
+        PollViewExtents(&proj);
+        PollChunkStreamer();
+
+        if (toDoPlaceInstances)
+        {
+            CycleInstances();
+            toDoPlaceInstances = false;
+        }
+
+        if (modelFrameMoved && !PanningOrZooming())
+            viewDirty = true;
+
+        if ((moveDeltaX != 0) || (moveDeltaY != 0) || (rotAngleX != 0) || (rotAngleY != 0) || (mouseScroll != 1.0))
+            viewDirty = true;
+
         if (moveDeltaX != 0)
         {
             proj = glm::translate(proj, glm::vec3(1.0f, 0, 0) * moveDeltaX * glContextScaleX);
@@ -646,67 +2659,215 @@ int main(void)
             proj = glm::translate(proj, glm::vec3(-offsetMouseX * glContextScaleX, -offsetMouseY * glContextScaleY, 0.0));
         }
         
-        // Background
-
-        glUseProgram(shaderTextDraw);
+        if (viewDirty || !renderOnDemand)
+        {
+            // Background
 
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+            glUseProgram(shaderTextDraw);
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, texture);
 
-        glBindVertexArray(textVertexArray);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+            glBindVertexArray(textVertexArray);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
 
-        // Model
+            // Model
         
-        glBindVertexArray(modelVertexArray);
-        glEnableVertexAttribArray(0);
+            glBindVertexArray(modelVertexArray);
+            glEnableVertexAttribArray(0);
 
-        if (toDoOptimiseView)
-        {
-            glUseProgram(shaderTransformFeedback);
+            // An out-of-core model is framed by its bounds, an assembly by those of its parts
+            if (toDoOptimiseView && chunkStreamer)
+            {
+                OptimiseViewForBounds(view, chunkStreamer->Chunks().Bounds(), &proj);
+                toDoOptimiseView = false;
+                modelFrameDirty = true;
+            }
+            else if (toDoOptimiseView && !assemblyParts.empty())
+            {
+                OptimiseViewForParts(view, partsPool.instanceBounds, &proj);
+                toDoOptimiseView = false;
+                modelFrameDirty = true;
+            }
 
-            glUniformMatrix4fv(locationViewAtTransformFeedback, 1, GL_FALSE, &view[0][0]);
+            // The fit visits every vertex until the hull is known, so it waits for the welded mesh
+            if (toDoOptimiseView && !modelStreaming && (modelVerticesNumber > 0))
+            {
+                if (!modelHull.Empty())
+                {
+                    OptimiseViewForHull(view, modelHull, &proj);
+                }
+                else
+                {
+                    glUseProgram(shaderViewExtents);
+
+                    glUniformMatrix4fv(locationViewAtViewExtents, 1, GL_FALSE, &view[0][0]);
+                    glUniform3fv(locationPositionScaleAtViewExtents, 1, modelPositionScale);
+                    glUniform3fv(locationPositionOffsetAtViewExtents, 1, modelPositionOffset);
+
+                    RequestViewExtents();
+                }
+                toDoOptimiseView = false;
+                modelFrameDirty = true;
+            }
 
-            glBeginTransformFeedback(GL_TRIANGLES);
-            glDrawArrays(GL_TRIANGLES, 0, modelTrianglesNumber * 3);
-            glEndTransformFeedback();
+            int viewport[4];
+            glGetIntegerv(GL_VIEWPORT, viewport);
 
-            glFlush();
+            int frameWidth = viewport[2] + 2 * (int)(viewport[2] * MODEL_FRAME_MARGIN);
+            int frameHeight = viewport[3] + 2 * (int)(viewport[3] * MODEL_FRAME_MARGIN);
 
-            glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, modelPositionsLength * sizeof(float), modelPositions);
+            glm::vec2 frameScale, frameOffset;
+            PlaceModelFrame(proj, &frameScale, &frameOffset);
 
-            OptimiseView(view, &proj);
-            toDoOptimiseView = false;
-        }
-        
-        glUseProgram(shaderModelDraw);
-        
-        glClear(GL_DEPTH_BUFFER_BIT);
+            // While a pan or zoom goes on, the last model frame is only moved
+            bool moveFrame = PanningOrZooming() && !modelFrameDirty && (view == modelFrameView) &&
+                (frameWidth == modelFrameWidth) && (frameHeight == modelFrameHeight) && ModelFrameCovers(frameScale, frameOffset);
 
-        glUniformMatrix4fv(locationProjAtModelDraw, 1, GL_FALSE, &proj[0][0]);
-        glUniformMatrix4fv(locationViewAtModelDraw, 1, GL_FALSE, &view[0][0]);
-        
-        glUniform4fv(locationColor, 1, &modelColor[0]);
-        glEnable(GL_POLYGON_OFFSET_FILL);
-        glPolygonOffset(1.0f, 1.0f);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDrawArrays(GL_TRIANGLES, 0, modelTrianglesNumber * 3);
-        glDisable(GL_POLYGON_OFFSET_FILL);
-
-        glUniform4fv(locationColor, 1, &edgesColor[0]);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glDrawArrays(GL_TRIANGLES, 0, modelTrianglesNumber * 3);
-        
-        glDisableVertexAttribArray(0);
+            if (!moveFrame)
+            {
+                if ((frameWidth != modelFrameWidth) || (frameHeight != modelFrameHeight))
+                    CreateModelFrameTarget(frameWidth, frameHeight);
+
+                // The frame's clip space takes in the margins, at the window's pixel size
+                glm::mat4 frameProj = glm::scale(glm::mat4(1.0f), glm::vec3((float)viewport[2] / frameWidth, (float)viewport[3] / frameHeight, 1.0f)) * proj;
+                glm::mat4 clipFromModel = frameProj * view;
+
+                glBindFramebuffer(GL_FRAMEBUFFER, modelFramebuffer);
+                glViewport(0, 0, frameWidth, frameHeight);
+
+                glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                // A rotation draws a level of detail that suits the model's size on screen
+                const ModelLod* lod = middleMouseButtonPressed ? ChooseRotationLod() : nullptr;
+
+                // The model's clusters outside the view are culled before it is drawn; an out-of-core model picks
+                // its chunks instead and uploads those read since
+                if (chunkStreamer)
+                {
+                    PickChunks(clipFromModel, frameWidth, frameHeight);
+                    UploadReadChunks(OUT_OF_CORE_TRIANGLES_PER_FRAME);
+                }
+                else if (!assemblyParts.empty())
+                {
+                    CullParts(clipFromModel);
+                }
+                else if ((lod == nullptr) && (clusterCulling == ClusterCulling::GPU) && (clustersVertexArray != 0))
+                {
+                    glUseProgram(shaderClusterCull);
+                    glUniformMatrix4fv(locationClipFromModelAtClusterCull, 1, GL_FALSE, &clipFromModel[0][0]);
+                    WriteClusterCommands();
+                }
+                else if ((lod == nullptr) && (clusterCulling == ClusterCulling::CPU))
+                {
+                    CullClusters(modelClusters, &clipFromModel[0][0], visibleRanges);
+                }
+
+                unsigned int edgesVertexArray = (lod != nullptr) ? lod->edgesVertexArray : modelEdgesVertexArray;
+                int edgesIndicesNumber = (lod != nullptr) ? lod->edgesIndicesNumber : modelEdgesIndicesNumber;
+
+                if (lod != nullptr)
+                    glBindVertexArray(lod->vertexArray);
+
+                bool assembly = !assemblyParts.empty();
+
+                if (featureEdgesOnly && ((edgesVertexArray != 0) || assembly))
+                {
+                    glUseProgram(shaderPlainDraw);
+
+                    glUniformMatrix4fv(locationProjAtPlainDraw, 1, GL_FALSE, &frameProj[0][0]);
+                    glUniformMatrix4fv(locationViewAtPlainDraw, 1, GL_FALSE, &view[0][0]);
+                    glUniform3fv(locationPositionScaleAtPlainDraw, 1, modelPositionScale);
+                    glUniform3fv(locationPositionOffsetAtPlainDraw, 1, modelPositionOffset);
+                    glUniform1i(locationFromPartsAtPlainDraw, assembly);
+
+                    // The fill is pushed back so the lines on it pass the depth test
+                    glUniform4fv(locationColorAtPlainDraw, 1, &modelColor[0]);
+                    glUniform1i(locationPartColorsAtPlainDraw, true);
+                    glEnable(GL_POLYGON_OFFSET_FILL);
+                    glPolygonOffset(1.0f, 1.0f);
+                    if (assembly)
+                        DrawParts(false);
+                    else
+                        DrawModel(lod);
+                    glDisable(GL_POLYGON_OFFSET_FILL);
+
+                    glUniform4fv(locationColorAtPlainDraw, 1, &edgesColor[0]);
+                    glUniform1i(locationPartColorsAtPlainDraw, false);
+                    if (assembly)
+                    {
+                        DrawParts(true);
+                    }
+                    else
+                    {
+                        glBindVertexArray(edgesVertexArray);
+                        glDrawElements(GL_LINES, edgesIndicesNumber, GL_UNSIGNED_INT, 0);
+                    }
+                }
+                else
+                {
+                    glUseProgram(shaderModelDraw);
+
+                    glUniformMatrix4fv(locationProjAtModelDraw, 1, GL_FALSE, &frameProj[0][0]);
+                    glUniformMatrix4fv(locationViewAtModelDraw, 1, GL_FALSE, &view[0][0]);
+                    glUniform3fv(locationPositionScaleAtModelDraw, 1, modelPositionScale);
+                    glUniform3fv(locationPositionOffsetAtModelDraw, 1, modelPositionOffset);
+                    glUniform1i(locationFromPartsAtModelDraw, assembly);
+
+                    // The edges are shaded into the fill in the same pass
+                    glUniform4fv(locationColor, 1, &modelColor[0]);
+                    glUniform4fv(locationEdgesColor, 1, &edgesColor[0]);
+                    glUniform2f(locationViewportSize, (float)frameWidth, (float)frameHeight);
+                    if (assembly)
+                        DrawParts(false);
+                    else
+                        DrawModel(lod);
+                }
+
+                glBindVertexArray(modelVertexArray);
+
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+                modelFrameProj = frameProj;
+                modelFrameView = view;
+                modelFrameDirty = false;
+
+                PlaceModelFrame(proj, &frameScale, &frameOffset);
+            }
+
+            glDisableVertexAttribArray(0);
+
+            // The frame goes over the background; its colours are premultiplied by coverage, nothing where it was cleared
+            glUseProgram(shaderFrameDraw);
+
+            glUniform2fv(locationFrameScale, 1, &frameScale[0]);
+            glUniform2fv(locationFrameOffset, 1, &frameOffset[0]);
+
+            glBindTexture(GL_TEXTURE_2D, modelFrameTexture);
+            glBindVertexArray(textVertexArray);
+
+            glDisable(GL_DEPTH_TEST);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            glBlendFunc(GL_ONE, GL_ZERO);
+            glDisable(GL_BLEND);
+            glEnable(GL_DEPTH_TEST);
+
+            modelFrameMoved = moveFrame;
         
-        /* Swap front and back buffers */
-        glfwSwapBuffers(window);
+            /* Swap front and back buffers */
+            glfwSwapBuffers(window);
+
+            viewDirty = false;
+            lastFrameTime = glfwGetTime();
+        }
 
         moveDeltaX = 0;
         moveDeltaY = 0;
@@ -714,16 +2875,32 @@ int main(void)
         rotAngleY = 0;
         mouseScroll = 1.0;
 
-        /* Poll for and process events */
-        glfwPollEvents();
+        /* Wait for and process events */
+        WaitForEvents(lastFrameTime);
 
         if (middleMouseButtonPressed) Rotate3DModel(window);
         if (rightMouseButtonPressed) Move3DModel(window);
     }
 
     glDeleteProgram(shaderModelDraw);
+    glDeleteProgram(shaderPlainDraw);
+    glDeleteProgram(shaderFrameDraw);
+    glDeleteProgram(shaderClusterCull);
 
-    delete[] modelPositions;
+    // Caches still being written are finished, so a model closed right after it showed reopens from its cache
+    for (const std::unique_ptr<CacheJob>& job : cacheJobs)
+    {
+        while (!job->Done())
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    cacheJobs.clear();
+
+    loadJob.reset();
+    hullJob.reset();
+    lodJob.reset();
+    chunkStreamer.reset();
+    DiscardPendingBuffers();
+    DiscardPartLoads();
 
     glfwTerminate();
     return 0;
@@ -0,0 +1,187 @@
+#include "Benchmark.h"
+
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "SimdKernels.h"
+#include "StlLoader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+const char* SAMPLE_FILES_DIRECTORY{ "Sample_STL_files" };
+
+// Every kernel runs for at least this long, and the fastest run counts
+const double MIN_BENCHMARK_SECONDS{ 0.25 };
+
+const size_t ASCII_BENCHMARK_CHUNK_SIZE{ 1 << 22 };
+
+// Reads the triangle soup of an STL file
+static bool ReadStl(const std::string& filepath, Mesh& soup)
+{
+    MappedFile file;
+    if (!file.Open(filepath))
+        return false;
+
+    StlFormat format = DetectStlFormat(file.Data(), file.Size());
+
+    if (format == StlFormat::BINARY)
+    {
+        unsigned int trianglesNumber;
+        ReadBinaryStlHeader(file.Data(), file.Size(), trianglesNumber);
+
+        soup = Mesh((size_t)trianglesNumber * 3);
+        ParseBinaryStl(file.Data(), 0, trianglesNumber, soup.Positions());
+        return true;
+    }
+
+    if (format == StlFormat::ASCII)
+    {
+        const char* text = reinterpret_cast<const char*>(file.Data());
+
+        AsciiStlLayout layout;
+        SplitAsciiStl(text, file.Size(), ASCII_BENCHMARK_CHUNK_SIZE, layout);
+        CountAsciiStl(text, 0, layout.chunkBegin.size(), layout);
+        if (!PlaceAsciiStl(layout))
+            return false;
+
+        soup = Mesh(layout.trianglesNumber * 3);
+        StlBounds bounds = EmptyBounds();
+        return ParseAsciiStl(text, layout, 0, layout.chunkBegin.size(), soup.Positions(), bounds);
+    }
+
+    return false;
+}
+
+// Seconds of the fastest of the runs that fill MIN_BENCHMARK_SECONDS
+template <typename Kernel>
+static double TimeKernel(Kernel kernel)
+{
+    double fastest{ 1e9 };
+    double total{ 0 };
+
+    do
+    {
+        auto start = std::chrono::steady_clock::now();
+        kernel();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        fastest = std::min(fastest, seconds);
+        total += seconds;
+    } while (total < MIN_BENCHMARK_SECONDS);
+
+    return fastest;
+}
+
+static void Report(const char* kernelName, SimdLevel level, size_t pointsNumber, double seconds, double scalarSeconds, bool matches)
+{
+    std::cout << "  " << std::left << std::setw(24) << kernelName << std::setw(8) << SimdLevelName(level) << std::right << std::fixed
+        << std::setprecision(1) << std::setw(9) << pointsNumber / seconds / 1e6 << " Mpoints/s "
+        << std::setw(7) << pointsNumber * 3 * sizeof(float) / seconds / 1e9 << " GB/s "
+        << std::setprecision(2) << std::setw(6) << scalarSeconds / seconds << "x" << (matches ? "" : "  MISMATCH") << std::endl;
+}
+
+static void BenchmarkFile(const std::string& filepath)
+{
+    Mesh soup;
+    if (!ReadStl(filepath, soup))
+    {
+        std::cout << "Failed to read " << filepath << std::endl;
+        return;
+    }
+
+    soup.SplitPositions();
+
+    const float* points = soup.Positions();
+    size_t pointsNumber = soup.VerticesNumber();
+    std::vector<float> transformed(pointsNumber * 3);
+
+    std::cout << filepath << ": " << pointsNumber << " points" << std::endl;
+
+    // A rotation about a skewed axis and a translation, like a view matrix
+    float angle{ 0.7f };
+    float axis[3]{ 0.48f, 0.6f, 0.64f };
+    float c = std::cos(angle), s = std::sin(angle), t = 1.0f - c;
+    float matrix[16]{
+        t * axis[0] * axis[0] + c, t * axis[0] * axis[1] + s * axis[2], t * axis[0] * axis[2] - s * axis[1], 0.0f,
+        t * axis[0] * axis[1] - s * axis[2], t * axis[1] * axis[1] + c, t * axis[1] * axis[2] + s * axis[0], 0.0f,
+        t * axis[0] * axis[2] + s * axis[1], t * axis[1] * axis[2] - s * axis[0], t * axis[2] * axis[2] + c, 0.0f,
+        12.0f, -34.0f, 56.0f, 1.0f };
+
+    float scalarMinimum[3], scalarMaximum[3];
+    float scalarTransformedMinimum[3], scalarTransformedMaximum[3];
+    std::vector<float> scalarTransformed(pointsNumber * 3);
+
+    PointsBounds(points, pointsNumber, scalarMinimum, scalarMaximum, SimdLevel::SCALAR);
+    TransformPoints(matrix, points, pointsNumber, scalarTransformed.data(), SimdLevel::SCALAR);
+    TransformedBounds(matrix, points, pointsNumber, scalarTransformedMinimum, scalarTransformedMaximum, SimdLevel::SCALAR);
+
+    double scalarSeconds[3]{ 0, 0, 0 };
+
+    for (int i = 0; i <= (int)SupportedSimdLevel(); i++)
+    {
+        SimdLevel level = (SimdLevel)i;
+        float minimum[3], maximum[3];
+
+        double seconds = TimeKernel([&] { PointsBounds(points, pointsNumber, minimum, maximum, level); });
+        if (level == SimdLevel::SCALAR)
+            scalarSeconds[0] = seconds;
+        bool matches = (std::memcmp(minimum, scalarMinimum, sizeof(minimum)) == 0) && (std::memcmp(maximum, scalarMaximum, sizeof(maximum)) == 0);
+        Report("bounds", level, pointsNumber, seconds, scalarSeconds[0], matches);
+
+        seconds = TimeKernel([&] { TransformPoints(matrix, points, pointsNumber, transformed.data(), level); });
+        if (level == SimdLevel::SCALAR)
+            scalarSeconds[1] = seconds;
+        matches = (transformed == scalarTransformed);
+        Report("transform", level, pointsNumber, seconds, scalarSeconds[1], matches);
+
+        seconds = TimeKernel([&] { TransformedBounds(matrix, points, pointsNumber, minimum, maximum, level); });
+        if (level == SimdLevel::SCALAR)
+            scalarSeconds[2] = seconds;
+        matches = (std::memcmp(minimum, scalarTransformedMinimum, sizeof(minimum)) == 0) &&
+            (std::memcmp(maximum, scalarTransformedMaximum, sizeof(maximum)) == 0);
+        Report("transform + bounds", level, pointsNumber, seconds, scalarSeconds[2], matches);
+
+        // The same from the coordinate arrays, against the scalar kernel over the interleaved points
+        seconds = TimeKernel([&]
+        {
+            TransformedBounds(matrix, soup.Component(0), soup.Component(1), soup.Component(2), pointsNumber, minimum, maximum, level);
+        });
+        matches = (std::memcmp(minimum, scalarTransformedMinimum, sizeof(minimum)) == 0) &&
+            (std::memcmp(maximum, scalarTransformedMaximum, sizeof(maximum)) == 0);
+        Report("split transform+bounds", level, pointsNumber, seconds, scalarSeconds[2], matches);
+    }
+}
+
+int RunBenchmark(const std::vector<std::string>& filepaths)
+{
+    std::vector<std::string> files = filepaths;
+
+    if (files.empty())
+    {
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(SAMPLE_FILES_DIRECTORY, error))
+            if (entry.path().extension() == ".stl")
+                files.push_back(entry.path().u8string());
+
+        std::sort(files.begin(), files.end());
+    }
+
+    if (files.empty())
+    {
+        std::cout << "No STL files to benchmark" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Point kernels, widest supported: " << SimdLevelName(SupportedSimdLevel()) << std::endl;
+
+    for (const std::string& filepath : files)
+        BenchmarkFile(filepath);
+
+    return 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Times the point kernels at every supported instruction set on the vertices of the given STL files,
+// or of the sample files when none are given, and prints their throughput; returns the exit code
+int RunBenchmark(const std::vector<std::string>& filepaths);
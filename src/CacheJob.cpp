@@ -0,0 +1,62 @@
+#include "CacheJob.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+
+// Bytes written between two cancellation checks, so a cancelled job is joined quickly
+const size_t CACHE_BYTES_PER_BATCH{ 1 << 24 };
+
+CacheJob::CacheJob(LoadedModel& model, std::shared_ptr<const Mesh> mesh)
+    : m_CachePath(StlCachePath(model.filepath)), m_Source(model.source), m_IndexOrder(model.indexOrder),
+    m_VertexFormat(model.vertexFormat), m_CreaseAngle(model.creaseAngle), m_Bounds(model.bounds), m_Mesh(std::move(mesh)),
+    m_StoredVertices(std::move(model.storedVertices)), m_Clusters(model.clusters), m_FeatureEdges(model.featureEdges)
+{
+    m_Thread = std::thread(&CacheJob::Run, this);
+}
+
+CacheJob::~CacheJob()
+{
+    m_Cancelled = true;
+    m_Thread.join();
+}
+
+void CacheJob::Run()
+{
+    size_t verticesNumber = m_Mesh->VerticesNumber();
+    size_t indicesNumber = m_Mesh->IndicesNumber();
+    size_t vertexSize = VertexSize(m_VertexFormat);
+
+    StlCacheWriter cacheWriter;
+    bool writing = cacheWriter.Begin(m_CachePath, m_Source, m_IndexOrder, m_VertexFormat, m_CreaseAngle, indicesNumber / 3, verticesNumber,
+        m_Clusters.size(), m_FeatureEdges.lines.size(), m_FeatureEdges.meshEdgesNumber);
+
+    const unsigned char* vertices = m_StoredVertices.empty() ? reinterpret_cast<const unsigned char*>(m_Mesh->Positions()) : m_StoredVertices.data();
+
+    size_t verticesPerBatch = CACHE_BYTES_PER_BATCH / vertexSize;
+    for (size_t vertex = 0; writing && (vertex < verticesNumber) && !m_Cancelled; vertex += verticesPerBatch)
+    {
+        size_t batchSize = std::min(verticesPerBatch, verticesNumber - vertex);
+        cacheWriter.AppendVertices(vertices + vertex * vertexSize, batchSize);
+    }
+
+    size_t indicesPerBatch = CACHE_BYTES_PER_BATCH / sizeof(uint32_t);
+    for (size_t index = 0; writing && (index < indicesNumber) && !m_Cancelled; index += indicesPerBatch)
+        cacheWriter.AppendIndices(m_Mesh->Indices() + index, std::min(indicesPerBatch, indicesNumber - index));
+
+    // An unfinished writer deletes its file
+    if (writing && !m_Cancelled)
+    {
+        cacheWriter.AppendClusters(m_Clusters.data(), m_Clusters.size());
+        cacheWriter.AppendEdges(m_FeatureEdges.lines.data(), m_FeatureEdges.lines.size());
+        m_Written = cacheWriter.Finish(m_Bounds);
+    }
+
+    m_Mesh.reset();
+    m_StoredVertices = std::vector<unsigned char>();
+
+    m_Done = true;
+
+    // Wake up the render loop if it waits for events
+    glfwPostEmptyEvent();
+}
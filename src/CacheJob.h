@@ -0,0 +1,54 @@
+#pragma once
+
+#include "FeatureEdges.h"
+#include "LoadJob.h"
+#include "Mesh.h"
+#include "MeshClusters.h"
+#include "StlCache.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes the cache of a parsed model on a background thread once the model is shown, so its first display
+// never waits for the disk. The welded mesh is shared with the other jobs and kept until the cache is written;
+// a cancelled job leaves no cache behind.
+class CacheJob
+{
+public:
+    // Takes over the model's stored vertices, if any; model.toCache must be set
+    CacheJob(LoadedModel& model, std::shared_ptr<const Mesh> mesh);
+    ~CacheJob();
+
+    CacheJob(const CacheJob&) = delete;
+    CacheJob& operator=(const CacheJob&) = delete;
+
+    bool Done() const { return m_Done; }
+    const std::string& CachePath() const { return m_CachePath; }
+
+    // Valid once Done()
+    bool Written() const { return m_Written; }
+
+private:
+    void Run();
+
+    std::string m_CachePath;
+    StlSourceStamp m_Source;
+    IndexOrder m_IndexOrder;
+    VertexFormat m_VertexFormat;
+    float m_CreaseAngle;
+    StlBounds m_Bounds;
+
+    std::shared_ptr<const Mesh> m_Mesh;
+    std::vector<unsigned char> m_StoredVertices;
+    std::vector<ClusterNode> m_Clusters;
+    FeatureEdges m_FeatureEdges;
+
+    bool m_Written{ false };
+    std::atomic<bool> m_Done{ false };
+    std::atomic<bool> m_Cancelled{ false };
+
+    std::thread m_Thread;
+};
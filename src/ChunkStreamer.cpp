@@ -0,0 +1,92 @@
+#include "ChunkStreamer.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+
+// Chunks read ahead of the render thread taking them, which bounds the memory they hold
+const size_t MAX_READ_CHUNKS{ 4 };
+
+ChunkStreamer::ChunkStreamer(std::unique_ptr<StlChunks> chunks)
+    : m_Chunks(std::move(chunks))
+{
+    m_Thread = std::thread(&ChunkStreamer::Run, this);
+}
+
+ChunkStreamer::~ChunkStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopped = true;
+    }
+    m_Condition.notify_all();
+    m_Thread.join();
+}
+
+void ChunkStreamer::Want(const std::vector<uint32_t>& chunks)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        m_Wanted.clear();
+        for (uint32_t chunk : chunks)
+        {
+            bool pending = (chunk == m_Reading) ||
+                std::any_of(m_Read.begin(), m_Read.end(), [chunk](const ReadChunk& read) { return read.chunk == chunk; });
+
+            if (!pending)
+                m_Wanted.push_back(chunk);
+        }
+    }
+    m_Condition.notify_all();
+}
+
+bool ChunkStreamer::TakeRead(ReadChunk& read)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Read.empty())
+            return false;
+
+        read = std::move(m_Read.front());
+        m_Read.pop_front();
+        m_ReadNumber = m_Read.size();
+    }
+    m_Condition.notify_all();
+
+    return true;
+}
+
+void ChunkStreamer::Run()
+{
+    while (true)
+    {
+        ReadChunk read;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this] { return m_Stopped || (!m_Wanted.empty() && (m_Read.size() < MAX_READ_CHUNKS)); });
+
+            if (m_Stopped)
+                return;
+
+            read.chunk = m_Wanted.front();
+            m_Wanted.pop_front();
+            m_Reading = read.chunk;
+        }
+
+        // Copying out of the mapping is where the file is actually read
+        const StlChunk& chunk = m_Chunks->Chunks()[read.chunk];
+        const float* positions = m_Chunks->Positions(chunk);
+        read.positions.assign(positions, positions + chunk.trianglesNumber * 9);
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Read.push_back(std::move(read));
+            m_ReadNumber = m_Read.size();
+            m_Reading = UINT32_MAX;
+        }
+
+        // Wake up the render loop if it waits for events
+        glfwPostEmptyEvent();
+    }
+}
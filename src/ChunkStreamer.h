@@ -0,0 +1,57 @@
+#pragma once
+
+#include "StlChunks.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A chunk's triangle soup read from the chunk file, 9 floats per triangle
+struct ReadChunk
+{
+    uint32_t chunk{ 0 };
+    std::vector<float> positions;
+};
+
+// Reads the chunks of an out-of-core model from its mapped chunk file on a background thread, so page faults
+// on the file never stall a frame. The render thread tells it every frame which chunks it wants, most wanted
+// first, and takes the ones read since.
+class ChunkStreamer
+{
+public:
+    explicit ChunkStreamer(std::unique_ptr<StlChunks> chunks);
+    ~ChunkStreamer();
+
+    ChunkStreamer(const ChunkStreamer&) = delete;
+    ChunkStreamer& operator=(const ChunkStreamer&) = delete;
+
+    const StlChunks& Chunks() const { return *m_Chunks; }
+
+    // Replaces the chunks still to read; one already read or being read is not read again until taken
+    void Want(const std::vector<uint32_t>& chunks);
+
+    // Moves the chunk read first into read and returns true, if any
+    bool TakeRead(ReadChunk& read);
+    bool HasRead() const { return m_ReadNumber > 0; }
+
+private:
+    void Run();
+
+    std::unique_ptr<StlChunks> m_Chunks;
+
+    std::deque<uint32_t> m_Wanted;
+    std::deque<ReadChunk> m_Read;
+    uint32_t m_Reading{ UINT32_MAX };
+    bool m_Stopped{ false };
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+
+    std::atomic<size_t> m_ReadNumber{ 0 };
+
+    std::thread m_Thread;
+};
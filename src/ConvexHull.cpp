@@ -0,0 +1,441 @@
+#include "ConvexHull.h"
+
+#include "Parallel.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+const size_t MIN_POINTS_PER_WORKER{ 1 << 16 };
+
+struct HullFace
+{
+    uint32_t vertices[3];
+
+    // Across the edge from vertices[i] to vertices[(i + 1) % 3]
+    int32_t neighbours[3];
+
+    // Outward unit normal, and its dot product with the points of the face
+    double normal[3];
+    double offset;
+
+    // Points above the face that are not assigned to another face
+    std::vector<uint32_t> outside;
+
+    bool alive;
+};
+
+struct HorizonEdge
+{
+    uint32_t from;
+    uint32_t to;
+    int32_t outerFace;
+};
+
+// Quickhull (Barber, Dobkin and Huhdanpaa 1996) over a subset of the points: starts from a tetrahedron and
+// repeatedly adds the farthest point above a face, replacing the faces it sees with a cone to their horizon
+class Quickhull
+{
+public:
+    Quickhull(const float* points, const std::atomic<bool>& cancelled)
+        : m_Points(points), m_Cancelled(cancelled)
+    {
+    }
+
+    // Returns the candidates on the hull; all of them if they are flat, the extremes if they are on a line
+    std::vector<uint32_t> Build(const std::vector<uint32_t>& candidates);
+
+private:
+    double Distance(const HullFace& face, uint32_t point) const;
+    double SquaredDistance(uint32_t first, uint32_t second) const;
+
+    int32_t AddFace(uint32_t a, uint32_t b, uint32_t c);
+    void AssignOutside(const std::vector<int32_t>& faces, uint32_t point);
+    void AddFarthestPoint(int32_t faceIndex);
+
+    const float* m_Points;
+    const std::atomic<bool>& m_Cancelled;
+
+    double m_Tolerance{ 0 };
+
+    std::vector<HullFace> m_Faces;
+    std::vector<int32_t> m_FreeFaces;
+    std::vector<int32_t> m_Pending;
+
+    // Scratch of AddFarthestPoint(), kept to save allocations
+    std::vector<int32_t> m_Visible;
+    std::vector<uint32_t> m_VisitedAt;
+    std::vector<char> m_IsVisible;
+    uint32_t m_Step{ 0 };
+    std::vector<HorizonEdge> m_Horizon;
+    std::vector<int32_t> m_NewFaces;
+    std::unordered_map<uint32_t, int32_t> m_NewFaceFrom;
+    std::unordered_map<uint32_t, int32_t> m_NewFaceTo;
+};
+
+double Quickhull::Distance(const HullFace& face, uint32_t point) const
+{
+    const float* p = m_Points + point * 3;
+    return face.normal[0] * p[0] + face.normal[1] * p[1] + face.normal[2] * p[2] - face.offset;
+}
+
+double Quickhull::SquaredDistance(uint32_t first, uint32_t second) const
+{
+    double squared{ 0 };
+    for (int axis = 0; axis < 3; axis++)
+    {
+        double difference = (double)m_Points[first * 3 + axis] - m_Points[second * 3 + axis];
+        squared += difference * difference;
+    }
+    return squared;
+}
+
+int32_t Quickhull::AddFace(uint32_t a, uint32_t b, uint32_t c)
+{
+    int32_t index;
+    if (!m_FreeFaces.empty())
+    {
+        index = m_FreeFaces.back();
+        m_FreeFaces.pop_back();
+    }
+    else
+    {
+        index = (int32_t)m_Faces.size();
+        m_Faces.emplace_back();
+    }
+
+    HullFace& face = m_Faces[index];
+    face.vertices[0] = a;
+    face.vertices[1] = b;
+    face.vertices[2] = c;
+    face.neighbours[0] = face.neighbours[1] = face.neighbours[2] = -1;
+    face.outside.clear();
+    face.alive = true;
+
+    const float* pa = m_Points + a * 3;
+    const float* pb = m_Points + b * 3;
+    const float* pc = m_Points + c * 3;
+
+    double ab[3]{ (double)pb[0] - pa[0], (double)pb[1] - pa[1], (double)pb[2] - pa[2] };
+    double ac[3]{ (double)pc[0] - pa[0], (double)pc[1] - pa[1], (double)pc[2] - pa[2] };
+
+    face.normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+    face.normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+    face.normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+
+    // A sliver face gets no normal, so no point is ever above it
+    double length = std::sqrt(face.normal[0] * face.normal[0] + face.normal[1] * face.normal[1] + face.normal[2] * face.normal[2]);
+    for (int axis = 0; axis < 3; axis++)
+        face.normal[axis] = (length > 0) ? face.normal[axis] / length : 0.0;
+
+    face.offset = face.normal[0] * pa[0] + face.normal[1] * pa[1] + face.normal[2] * pa[2];
+
+    return index;
+}
+
+void Quickhull::AssignOutside(const std::vector<int32_t>& faces, uint32_t point)
+{
+    int32_t farthestFace{ -1 };
+    double farthest = m_Tolerance;
+
+    for (int32_t face : faces)
+    {
+        double distance = Distance(m_Faces[face], point);
+        if (distance > farthest)
+        {
+            farthest = distance;
+            farthestFace = face;
+        }
+    }
+
+    if (farthestFace >= 0)
+        m_Faces[farthestFace].outside.push_back(point);
+}
+
+void Quickhull::AddFarthestPoint(int32_t faceIndex)
+{
+    uint32_t eye = m_Faces[faceIndex].outside[0];
+    double farthest{ 0 };
+    for (uint32_t point : m_Faces[faceIndex].outside)
+    {
+        double distance = Distance(m_Faces[faceIndex], point);
+        if (distance > farthest)
+        {
+            farthest = distance;
+            eye = point;
+        }
+    }
+
+    // The faces the eye sees, found from this one; their border with the rest is the horizon
+    m_Step++;
+    m_VisitedAt.resize(m_Faces.size(), 0);
+    m_IsVisible.resize(m_Faces.size(), 0);
+
+    m_Visible.clear();
+    m_Horizon.clear();
+
+    m_Visible.push_back(faceIndex);
+    m_VisitedAt[faceIndex] = m_Step;
+    m_IsVisible[faceIndex] = 1;
+
+    for (size_t i = 0; i < m_Visible.size(); i++)
+    {
+        const HullFace& visible = m_Faces[m_Visible[i]];
+
+        for (int edge = 0; edge < 3; edge++)
+        {
+            int32_t neighbour = visible.neighbours[edge];
+
+            if (m_VisitedAt[neighbour] != m_Step)
+            {
+                m_VisitedAt[neighbour] = m_Step;
+                m_IsVisible[neighbour] = (Distance(m_Faces[neighbour], eye) > m_Tolerance) ? 1 : 0;
+
+                if (m_IsVisible[neighbour])
+                    m_Visible.push_back(neighbour);
+            }
+
+            if (!m_IsVisible[neighbour])
+                m_Horizon.push_back({ visible.vertices[edge], visible.vertices[(edge + 1) % 3], neighbour });
+        }
+    }
+
+    // A cone of new faces from every horizon edge to the eye
+    m_NewFaces.clear();
+    m_NewFaceFrom.clear();
+    m_NewFaceTo.clear();
+
+    for (const HorizonEdge& edge : m_Horizon)
+    {
+        int32_t created = AddFace(edge.from, edge.to, eye);
+        m_Faces[created].neighbours[0] = edge.outerFace;
+
+        HullFace& outer = m_Faces[edge.outerFace];
+        for (int outerEdge = 0; outerEdge < 3; outerEdge++)
+            if ((outer.vertices[outerEdge] == edge.to) && (outer.vertices[(outerEdge + 1) % 3] == edge.from))
+                outer.neighbours[outerEdge] = created;
+
+        m_NewFaceFrom[edge.from] = created;
+        m_NewFaceTo[edge.to] = created;
+        m_NewFaces.push_back(created);
+    }
+
+    // Face (u, v, eye) shares the edge from v to the eye with the face of the horizon edge leaving v,
+    // and the edge from the eye to u with the one of the horizon edge arriving at u
+    for (int32_t created : m_NewFaces)
+    {
+        HullFace& face = m_Faces[created];
+        face.neighbours[1] = m_NewFaceFrom[face.vertices[1]];
+        face.neighbours[2] = m_NewFaceTo[face.vertices[0]];
+    }
+
+    // Points above the faces that went either move to a new face or are inside the hull now
+    for (int32_t visible : m_Visible)
+    {
+        std::vector<uint32_t> outside;
+        outside.swap(m_Faces[visible].outside);
+        m_Faces[visible].alive = false;
+        m_FreeFaces.push_back(visible);
+
+        for (uint32_t point : outside)
+            if (point != eye)
+                AssignOutside(m_NewFaces, point);
+    }
+
+    for (int32_t created : m_NewFaces)
+        if (!m_Faces[created].outside.empty())
+            m_Pending.push_back(created);
+}
+
+std::vector<uint32_t> Quickhull::Build(const std::vector<uint32_t>& candidates)
+{
+    if (candidates.size() < 4)
+        return candidates;
+
+    // The smallest and largest point along every axis
+    uint32_t extremes[6];
+    double largestAbsolute[3]{ 0, 0, 0 };
+
+    for (int axis = 0; axis < 3; axis++)
+        extremes[axis * 2] = extremes[axis * 2 + 1] = candidates[0];
+
+    for (uint32_t point : candidates)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float value = m_Points[point * 3 + axis];
+            if (value < m_Points[extremes[axis * 2] * 3 + axis])
+                extremes[axis * 2] = point;
+            if (value > m_Points[extremes[axis * 2 + 1] * 3 + axis])
+                extremes[axis * 2 + 1] = point;
+
+            largestAbsolute[axis] = std::max(largestAbsolute[axis], (double)std::fabs(value));
+        }
+    }
+
+    // Float positions are only exact to their rounding, so a point this close to a face is on it
+    m_Tolerance = 3.0 * (largestAbsolute[0] + largestAbsolute[1] + largestAbsolute[2]) * FLT_EPSILON;
+
+    // The tetrahedron: the two extremes farthest apart, the point farthest from their line
+    // and the one farthest from the plane of the three
+    uint32_t a = extremes[0], b = extremes[1];
+    double farthest{ -1 };
+    for (int first = 0; first < 6; first++)
+        for (int second = first + 1; second < 6; second++)
+        {
+            double squared = SquaredDistance(extremes[first], extremes[second]);
+            if (squared > farthest)
+            {
+                farthest = squared;
+                a = extremes[first];
+                b = extremes[second];
+            }
+        }
+
+    if (std::sqrt(farthest) <= m_Tolerance)
+        return { a };
+
+    const float* pa = m_Points + a * 3;
+    double ab[3]{ (double)m_Points[b * 3] - pa[0], (double)m_Points[b * 3 + 1] - pa[1], (double)m_Points[b * 3 + 2] - pa[2] };
+    double abSquared = ab[0] * ab[0] + ab[1] * ab[1] + ab[2] * ab[2];
+
+    uint32_t c = a;
+    farthest = -1;
+    for (uint32_t point : candidates)
+    {
+        const float* p = m_Points + point * 3;
+        double ap[3]{ (double)p[0] - pa[0], (double)p[1] - pa[1], (double)p[2] - pa[2] };
+        double cross[3]{ ab[1] * ap[2] - ab[2] * ap[1], ab[2] * ap[0] - ab[0] * ap[2], ab[0] * ap[1] - ab[1] * ap[0] };
+
+        double squared = (cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]) / abSquared;
+        if (squared > farthest)
+        {
+            farthest = squared;
+            c = point;
+        }
+    }
+
+    if (std::sqrt(farthest) <= m_Tolerance)
+        return { a, b };
+
+    int32_t base = AddFace(a, b, c);
+
+    uint32_t d = a;
+    farthest = -1;
+    for (uint32_t point : candidates)
+    {
+        double distance = std::fabs(Distance(m_Faces[base], point));
+        if (distance > farthest)
+        {
+            farthest = distance;
+            d = point;
+        }
+    }
+
+    if (farthest <= m_Tolerance)
+        return candidates;
+
+    // Wound so every face looks away from the fourth point
+    bool dAbove = Distance(m_Faces[base], d) > 0;
+    m_Faces.clear();
+    if (dAbove)
+        std::swap(b, c);
+
+    int32_t faces[4]{ AddFace(a, b, c), AddFace(a, c, d), AddFace(c, b, d), AddFace(b, a, d) };
+
+    for (int32_t face : faces)
+        for (int edge = 0; edge < 3; edge++)
+        {
+            uint32_t from = m_Faces[face].vertices[edge];
+            uint32_t to = m_Faces[face].vertices[(edge + 1) % 3];
+
+            for (int32_t other : faces)
+                for (int otherEdge = 0; otherEdge < 3; otherEdge++)
+                    if ((m_Faces[other].vertices[otherEdge] == to) && (m_Faces[other].vertices[(otherEdge + 1) % 3] == from))
+                        m_Faces[face].neighbours[edge] = other;
+        }
+
+    std::vector<int32_t> initialFaces(faces, faces + 4);
+    for (uint32_t point : candidates)
+        AssignOutside(initialFaces, point);
+
+    for (int32_t face : faces)
+        if (!m_Faces[face].outside.empty())
+            m_Pending.push_back(face);
+
+    while (!m_Pending.empty())
+    {
+        if (m_Cancelled)
+            return {};
+
+        int32_t face = m_Pending.back();
+        m_Pending.pop_back();
+
+        if (m_Faces[face].alive && !m_Faces[face].outside.empty())
+            AddFarthestPoint(face);
+    }
+
+    std::vector<uint32_t> hull;
+    for (const HullFace& face : m_Faces)
+        if (face.alive)
+            hull.insert(hull.end(), face.vertices, face.vertices + 3);
+
+    std::sort(hull.begin(), hull.end());
+    hull.erase(std::unique(hull.begin(), hull.end()), hull.end());
+
+    return hull;
+}
+
+Mesh ComputeConvexHull(const float* points, size_t pointsNumber, const std::atomic<bool>& cancelled)
+{
+    // The hull of every part, then the hull of those: a point inside a part's hull is inside the whole one
+    unsigned int workers = WorkerCount(pointsNumber, MIN_POINTS_PER_WORKER);
+    std::vector<std::vector<uint32_t>> partHulls(workers);
+
+    ParallelFor(pointsNumber, MIN_POINTS_PER_WORKER, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        std::vector<uint32_t> candidates(end - begin);
+        for (size_t point = begin; point < end; point++)
+            candidates[point - begin] = static_cast<uint32_t>(point);
+
+        partHulls[worker] = Quickhull(points, cancelled).Build(candidates);
+    });
+
+    std::vector<uint32_t> hull = std::move(partHulls[0]);
+    if (workers > 1)
+    {
+        for (unsigned int worker = 1; worker < workers; worker++)
+            hull.insert(hull.end(), partHulls[worker].begin(), partHulls[worker].end());
+
+        hull = Quickhull(points, cancelled).Build(hull);
+    }
+
+    if (cancelled)
+        return {};
+
+    Mesh hullPoints(hull.size());
+    for (size_t point = 0; point < hull.size(); point++)
+        for (int axis = 0; axis < 3; axis++)
+            hullPoints.Positions()[point * 3 + axis] = points[hull[point] * 3 + axis];
+
+    hullPoints.SplitPositions();
+    return hullPoints;
+}
+
+void ExtentAlong(const Mesh& hull, const float direction[3], float& minimum, float& maximum)
+{
+    minimum = maximum = 0.0f;
+    if (hull.Empty())
+        return;
+
+    // The direction is the first row of the matrix
+    float matrix[16]{ direction[0], 0, 0, 0, direction[1], 0, 0, 0, direction[2], 0, 0, 0, 0, 0, 0, 1 };
+    float minimums[3], maximums[3];
+    TransformedBounds(matrix, hull.Component(0), hull.Component(1), hull.Component(2), hull.VerticesNumber(), minimums, maximums);
+
+    minimum = minimums[0];
+    maximum = maximums[0];
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Mesh.h"
+
+#include <atomic>
+#include <cstddef>
+
+// Returns the points (3 floats each) on the convex hull of points as a mesh without triangles, split into
+// coordinate arrays. The hull is found with quickhull on parts of the points in parallel and then on the
+// union of their hulls. A point closer to the hull than the rounding tolerance may be left out, moving an
+// extent by no more than that; a flat set is returned whole. Returns an empty hull once cancelled is set.
+Mesh ComputeConvexHull(const float* points, size_t pointsNumber, const std::atomic<bool>& cancelled);
+
+// Smallest and largest dot product of direction with the hull points, the extent of the whole point set
+void ExtentAlong(const Mesh& hull, const float direction[3], float& minimum, float& maximum);
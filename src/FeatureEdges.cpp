@@ -0,0 +1,212 @@
+#include "FeatureEdges.h"
+
+#include "Parallel.h"
+
+#include <cmath>
+
+const size_t MIN_TRIANGLES_PER_WORKER{ 1 << 15 };
+const size_t MIN_EDGES_PER_WORKER{ 1 << 16 };
+
+// Half-edges a worker scans between two cancellation checks
+const size_t EDGES_PER_CANCEL_CHECK{ 1 << 16 };
+
+// No edge has this key, its first vertex would have to be its last one
+const uint64_t EMPTY_EDGE{ UINT64_MAX };
+
+// An edge seen from either triangle has the same key
+static uint64_t EdgeKey(uint32_t a, uint32_t b)
+{
+    return (a < b) ? ((uint64_t)a << 32 | b) : ((uint64_t)b << 32 | a);
+}
+
+static uint32_t HashEdge(uint64_t key)
+{
+    uint64_t hash = key * 0x9E3779B97F4A7C15ull;
+    hash ^= hash >> 29;
+
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+static size_t TableSize(size_t entries)
+{
+    size_t size{ 16 };
+    while (size <= entries)
+        size *= 2;
+    return size;
+}
+
+// Unit normal of every triangle, or 0 without area
+static std::vector<float> FaceNormals(const float* vertices, const uint32_t* indices, size_t trianglesNumber)
+{
+    std::vector<float> normals(trianglesNumber * 3);
+
+    ParallelFor(trianglesNumber, MIN_TRIANGLES_PER_WORKER, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        for (size_t triangle = begin; triangle < end; triangle++)
+        {
+            const float* a = vertices + indices[triangle * 3] * 3;
+            const float* b = vertices + indices[triangle * 3 + 1] * 3;
+            const float* c = vertices + indices[triangle * 3 + 2] * 3;
+
+            float u[3]{ b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            float v[3]{ c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+            float n[3]{ u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+
+            float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            float scale = (length > 0.0f) ? 1.0f / length : 0.0f;
+
+            for (int axis = 0; axis < 3; axis++)
+                normals[triangle * 3 + axis] = n[axis] * scale;
+        }
+    });
+
+    return normals;
+}
+
+// Half-edge i runs from corner i to the next corner of triangle i / 3
+static uint32_t EdgeEnd(const uint32_t* indices, size_t edge)
+{
+    return indices[(edge % 3 == 2) ? edge - 2 : edge + 1];
+}
+
+FeatureEdges ExtractFeatureEdges(const float* vertices, const uint32_t* indices, size_t indicesNumber, float creaseAngle,
+    const std::atomic<bool>& cancelled)
+{
+    FeatureEdges result;
+
+    size_t trianglesNumber = indicesNumber / 3;
+    std::vector<float> normals = FaceNormals(vertices, indices, trianglesNumber);
+
+    const float creaseCosine = std::cos(creaseAngle * 3.14159265f / 180.0f);
+
+    std::vector<uint32_t> hashes(indicesNumber);
+
+    ParallelFor(indicesNumber, MIN_EDGES_PER_WORKER, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        for (size_t edge = begin; edge < end; edge++)
+            hashes[edge] = HashEdge(EdgeKey(indices[edge], EdgeEnd(indices, edge)));
+    });
+
+    unsigned int partitions = WorkerCount(indicesNumber, MIN_EDGES_PER_WORKER);
+    std::vector<size_t> partitionEdges(partitions, 0);
+
+    for (size_t edge = 0; edge < indicesNumber; edge++)
+        partitionEdges[(uint64_t)hashes[edge] * partitions >> 32]++;
+
+    // Set on the first half-edge of every feature edge; partitions own disjoint half-edges
+    std::vector<uint8_t> features(indicesNumber, 0);
+    std::vector<size_t> uniqueEdges(partitions, 0);
+
+    struct EdgeSlot
+    {
+        uint64_t key;
+        uint32_t firstEdge;
+        uint16_t triangles;
+        uint16_t crease;
+    };
+
+    ParallelFor(partitions, 1, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        for (size_t partition = begin; partition < end; partition++)
+        {
+            std::vector<EdgeSlot> table(TableSize(partitionEdges[partition]), EdgeSlot{ EMPTY_EDGE, 0, 0, 0 });
+            size_t mask = table.size() - 1;
+
+            for (size_t edge = 0; edge < indicesNumber; edge++)
+            {
+                if ((edge % EDGES_PER_CANCEL_CHECK == 0) && cancelled)
+                    return;
+
+                uint32_t hash = hashes[edge];
+                if (((uint64_t)hash * partitions >> 32) != partition)
+                    continue;
+
+                uint32_t a = indices[edge], b = EdgeEnd(indices, edge);
+                if (a == b)
+                    continue;
+
+                uint64_t key = EdgeKey(a, b);
+
+                for (size_t slot = hash & mask; ; slot = (slot + 1) & mask)
+                {
+                    EdgeSlot& entry = table[slot];
+
+                    if (entry.key == EMPTY_EDGE)
+                    {
+                        entry = EdgeSlot{ key, static_cast<uint32_t>(edge), 1, 0 };
+                        break;
+                    }
+
+                    if (entry.key == key)
+                    {
+                        if (entry.triangles == 1)
+                        {
+                            const float* first = normals.data() + (entry.firstEdge / 3) * 3;
+                            const float* second = normals.data() + (edge / 3) * 3;
+                            float cosine = first[0] * second[0] + first[1] * second[1] + first[2] * second[2];
+
+                            bool bothHaveArea = (first[0] != 0.0f || first[1] != 0.0f || first[2] != 0.0f) &&
+                                (second[0] != 0.0f || second[1] != 0.0f || second[2] != 0.0f);
+                            entry.crease = bothHaveArea && (cosine < creaseCosine);
+                        }
+
+                        if (entry.triangles < UINT16_MAX)
+                            entry.triangles++;
+                        break;
+                    }
+                }
+            }
+
+            for (const EdgeSlot& entry : table)
+            {
+                if (entry.key == EMPTY_EDGE)
+                    continue;
+
+                uniqueEdges[partition]++;
+                if ((entry.triangles != 2) || entry.crease)
+                    features[entry.firstEdge] = 1;
+            }
+        }
+    });
+
+    if (cancelled)
+        return FeatureEdges();
+
+    for (size_t edges : uniqueEdges)
+        result.meshEdgesNumber += edges;
+
+    // Collect in triangle order, which keeps the vertex locality of the triangle order
+    std::vector<size_t> workerFeatures(WorkerCount(indicesNumber, MIN_EDGES_PER_WORKER), 0);
+
+    ParallelFor(indicesNumber, MIN_EDGES_PER_WORKER, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        for (size_t edge = begin; edge < end; edge++)
+            workerFeatures[worker] += features[edge];
+    });
+
+    std::vector<size_t> workerFirstFeature(workerFeatures.size(), 0);
+    size_t featuresNumber{ 0 };
+    for (size_t worker = 0; worker < workerFeatures.size(); worker++)
+    {
+        workerFirstFeature[worker] = featuresNumber;
+        featuresNumber += workerFeatures[worker];
+    }
+
+    result.lines.resize(featuresNumber * 2);
+
+    ParallelFor(indicesNumber, MIN_EDGES_PER_WORKER, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        size_t feature = workerFirstFeature[worker];
+        for (size_t edge = begin; edge < end; edge++)
+        {
+            if (features[edge] == 0)
+                continue;
+
+            result.lines[feature * 2] = indices[edge];
+            result.lines[feature * 2 + 1] = EdgeEnd(indices, edge);
+            feature++;
+        }
+    });
+
+    return result;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Edges of a welded mesh worth drawing as lines
+struct FeatureEdges
+{
+    // Pairs of vertex indices, for GL_LINES, in the order the triangles first use the edges
+    std::vector<uint32_t> lines;
+
+    // Edges of the whole mesh, every one counted once
+    size_t meshEdgesNumber{ 0 };
+};
+
+// Finds the boundary edges (of one triangle), the non-manifold ones (of more than two) and the creases,
+// whose two triangles turn by more than creaseAngle degrees. Edges are matched through hash tables that
+// every worker keeps for its own partition of the edge hashes, so they need no locking.
+// Triangles without area have no normal and make no crease; edges between one vertex and itself are skipped.
+// Returns no edges once cancelled is set.
+FeatureEdges ExtractFeatureEdges(const float* vertices, const uint32_t* indices, size_t indicesNumber, float creaseAngle,
+    const std::atomic<bool>& cancelled);
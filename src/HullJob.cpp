@@ -0,0 +1,45 @@
+#include "HullJob.h"
+
+#include "ConvexHull.h"
+
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+
+HullJob::HullJob(std::shared_ptr<const Mesh> mesh)
+    : m_Mesh(std::move(mesh)), m_VerticesNumber(m_Mesh->VerticesNumber())
+{
+    m_Thread = std::thread(&HullJob::Run, this);
+}
+
+HullJob::HullJob(std::shared_ptr<const StlCache> cache)
+    : m_Cache(std::move(cache)), m_VerticesNumber(m_Cache->VerticesNumber())
+{
+    m_Thread = std::thread(&HullJob::Run, this);
+}
+
+HullJob::~HullJob()
+{
+    m_Cancelled = true;
+    m_Thread.join();
+}
+
+void HullJob::Run()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    if (m_Cache)
+    {
+        m_Mesh = std::make_shared<const Mesh>(m_Cache->DecodeMesh(false));
+        m_Cache.reset();
+    }
+
+    m_Hull = ComputeConvexHull(m_Mesh->Positions(), m_VerticesNumber, m_Cancelled);
+    m_Mesh.reset();
+
+    m_Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m_Done = true;
+
+    // Wake up the render loop if it waits for events
+    glfwPostEmptyEvent();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Mesh.h"
+#include "StlCache.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+
+// Computes the convex hull of a model's vertices on a background thread once it is loaded; the render
+// thread polls it once per frame
+class HullJob
+{
+public:
+    HullJob(std::shared_ptr<const Mesh> mesh);
+
+    // For a model read from its cache, whose positions the job decodes first
+    HullJob(std::shared_ptr<const StlCache> cache);
+    ~HullJob();
+
+    HullJob(const HullJob&) = delete;
+    HullJob& operator=(const HullJob&) = delete;
+
+    bool Done() const { return m_Done; }
+
+    // Valid once Done()
+    Mesh& Hull() { return m_Hull; }
+    size_t VerticesNumber() const { return m_VerticesNumber; }
+    double Seconds() const { return m_Seconds; }
+
+private:
+    void Run();
+
+    std::shared_ptr<const Mesh> m_Mesh;
+    std::shared_ptr<const StlCache> m_Cache;
+    size_t m_VerticesNumber;
+    Mesh m_Hull;
+    double m_Seconds{ 0 };
+
+    std::atomic<bool> m_Done{ false };
+    std::atomic<bool> m_Cancelled{ false };
+
+    std::thread m_Thread;
+};
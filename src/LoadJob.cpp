@@ -0,0 +1,391 @@
+#include "LoadJob.h"
+
+#include "MappedFile.h"
+#include "MeshWeld.h"
+#include "Parallel.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+// Work done between two progress updates and cancellation checks
+const size_t TRIANGLES_PER_BATCH{ 1 << 20 };
+const size_t ASCII_CHUNK_SIZE{ 1 << 22 };
+
+// Smaller models parse about as fast as their cache loads, so they leave no file behind
+const size_t CACHE_MIN_TRIANGLES{ 1 << 18 };
+
+// Progress reached once parsing, welding and reordering are done
+const float PARSE_PROGRESS{ 0.5f };
+const float WELD_PROGRESS{ 0.6f };
+const float ORDER_PROGRESS{ 0.9f };
+
+LoadJob::LoadJob(const std::string& filepath, IndexOrder indexOrder, VertexFormat vertexFormat, float creaseAngle, bool assemblyPart,
+    unsigned int workers)
+    : m_Filepath(filepath), m_IndexOrder(indexOrder), m_VertexFormat(vertexFormat), m_CreaseAngle(creaseAngle),
+    m_AssemblyPart(assemblyPart), m_Workers(workers)
+{
+    m_Result.filepath = filepath;
+    m_Result.vertexFormat = vertexFormat;
+    m_Thread = std::thread(&LoadJob::Run, this);
+}
+
+LoadJob::~LoadJob()
+{
+    Cancel();
+    m_Thread.join();
+}
+
+void LoadJob::Cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_DestinationMutex);
+        m_Cancelled = true;
+    }
+    m_DestinationCondition.notify_all();
+}
+
+void LoadJob::SetDestination(void* vertices, uint32_t* indices)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_DestinationMutex);
+        m_DestinationVertices = vertices;
+        m_DestinationIndices = indices;
+    }
+    m_DestinationCondition.notify_all();
+}
+
+void LoadJob::Fail(const std::string& error)
+{
+    m_Error = error;
+    m_State = m_Cancelled ? LoadState::CANCELLED : LoadState::FAILED;
+
+    // Wake up the render loop if it waits for events
+    glfwPostEmptyEvent();
+}
+
+StlBounds LoadJob::ParsedBounds()
+{
+    std::lock_guard<std::mutex> lock(m_BoundsMutex);
+    return m_Result.bounds;
+}
+
+bool LoadJob::StopIfCancelled()
+{
+    if (!m_Cancelled)
+        return false;
+
+    Fail("Cancelled");
+    return true;
+}
+
+void LoadJob::Publish(size_t trianglesParsed, const StlBounds& batchBounds)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_BoundsMutex);
+        MergeBounds(m_Result.bounds, batchBounds);
+    }
+    m_TrianglesParsed = trianglesParsed;
+}
+
+void LoadJob::Succeed(size_t fileSize, std::chrono::steady_clock::time_point loadStart)
+{
+    m_Result.fileSize = fileSize;
+    m_Result.parseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+
+    m_Progress = 1.0f;
+    m_State = LoadState::SUCCEEDED;
+
+    glfwPostEmptyEvent();
+}
+
+void LoadJob::Run()
+{
+    auto loadStart = std::chrono::steady_clock::now();
+
+    SetWorkerBudget(m_Workers);
+
+    MappedFile file;
+    if (!file.Open(m_Filepath))
+    {
+        Fail("Failed to open " + m_Filepath);
+        return;
+    }
+
+    StlSourceStamp stamp;
+    bool stamped = ReadStlSourceStamp(m_Filepath, file.Data(), file.Size(), stamp);
+
+    if (stamped)
+    {
+        auto cache = std::make_shared<StlCache>();
+        if (cache->Open(StlCachePath(m_Filepath), stamp, m_IndexOrder, m_VertexFormat, m_CreaseAngle))
+        {
+            m_TrianglesNumber = cache->TrianglesNumber();
+
+            m_Result.trianglesNumber = cache->TrianglesNumber();
+            m_Result.verticesNumber = cache->VerticesNumber();
+            m_Result.bounds = cache->Bounds();
+
+            // The buffers are uploaded from the mapping, and the jobs working on the welded mesh decode it from there
+            if (!m_AssemblyPart)
+                m_Result.clusters.assign(cache->Clusters(), cache->Clusters() + cache->ClustersNumber());
+            m_Result.featureEdges.lines.assign(cache->EdgesIndices(), cache->EdgesIndices() + cache->EdgesIndicesNumber());
+            m_Result.featureEdges.meshEdgesNumber = cache->MeshEdgesNumber();
+
+            m_Result.cache = std::move(cache);
+            m_Result.fromCache = true;
+
+            Succeed(file.Size(), loadStart);
+            return;
+        }
+    }
+
+    StlFormat format = DetectStlFormat(file.Data(), file.Size());
+    const char* text = reinterpret_cast<const char*>(file.Data());
+
+    size_t trianglesNumber{ 0 };
+    AsciiStlLayout asciiLayout;
+
+    if (format == StlFormat::BINARY)
+    {
+        unsigned int headerTrianglesNumber;
+        ReadBinaryStlHeader(file.Data(), file.Size(), headerTrianglesNumber);
+        trianglesNumber = headerTrianglesNumber;
+    }
+    else if (format == StlFormat::ASCII)
+    {
+        // The text carries no triangle count, so counting is the first half of parsing
+        SplitAsciiStl(text, file.Size(), ASCII_CHUNK_SIZE, asciiLayout);
+
+        size_t chunksNumber = asciiLayout.chunkBegin.size();
+        for (size_t chunk = 0; chunk < chunksNumber; chunk += WorkerBudget())
+        {
+            if (StopIfCancelled())
+                return;
+
+            size_t lastChunk = std::min(chunksNumber, chunk + WorkerBudget());
+            CountAsciiStl(text, chunk, lastChunk, asciiLayout);
+            m_Progress = PARSE_PROGRESS * 0.5f * lastChunk / chunksNumber;
+        }
+
+        if (!PlaceAsciiStl(asciiLayout))
+        {
+            Fail("Malformed ASCII STL: " + m_Filepath);
+            return;
+        }
+        trianglesNumber = asciiLayout.trianglesNumber;
+    }
+    else
+    {
+        Fail("Not an STL file or truncated: " + m_Filepath);
+        return;
+    }
+
+    if (trianglesNumber > OUT_OF_CORE_MIN_TRIANGLES)
+    {
+        // The chunks are bucketed straight from the mapped records, which ASCII does not have
+        if ((format != StlFormat::BINARY) || !stamped)
+        {
+            Fail("Files of more than " + std::to_string(OUT_OF_CORE_MIN_TRIANGLES) + " triangles must be binary STL: " + m_Filepath);
+            return;
+        }
+
+        SplitIntoChunks(file, stamp, trianglesNumber, loadStart);
+        return;
+    }
+
+    if (trianglesNumber < 1)
+    {
+        Fail("Unsupported number of triangles in " + m_Filepath);
+        return;
+    }
+
+    m_Result.bounds = EmptyBounds();
+    m_Result.soup = Mesh(trianglesNumber * 3);
+    float* positions = m_Result.soup.Positions();
+
+    m_TrianglesNumber = trianglesNumber;
+
+    if (format == StlFormat::BINARY)
+    {
+        for (size_t triangle = 0; triangle < trianglesNumber; triangle += TRIANGLES_PER_BATCH)
+        {
+            if (StopIfCancelled())
+                return;
+
+            size_t batchSize = std::min(TRIANGLES_PER_BATCH, trianglesNumber - triangle);
+            Publish(triangle + batchSize, ParseBinaryStl(file.Data(), triangle, batchSize, positions + triangle * 9));
+            m_Progress = PARSE_PROGRESS * (triangle + batchSize) / trianglesNumber;
+        }
+    }
+    else
+    {
+        size_t chunksNumber = asciiLayout.chunkBegin.size();
+        for (size_t chunk = 0; chunk < chunksNumber; chunk += WorkerBudget())
+        {
+            if (StopIfCancelled())
+                return;
+
+            size_t lastChunk = std::min(chunksNumber, chunk + WorkerBudget());
+            size_t firstTriangle = asciiLayout.chunkFirstTriangle[chunk];
+
+            StlBounds batchBounds = EmptyBounds();
+            if (!ParseAsciiStl(text, asciiLayout, chunk, lastChunk, positions + firstTriangle * 9, batchBounds))
+            {
+                Fail("Malformed ASCII STL: " + m_Filepath);
+                return;
+            }
+
+            size_t trianglesParsed = (lastChunk < chunksNumber) ? asciiLayout.chunkFirstTriangle[lastChunk] : trianglesNumber;
+            Publish(trianglesParsed, batchBounds);
+            m_Progress = PARSE_PROGRESS * (0.5f + 0.5f * lastChunk / chunksNumber);
+        }
+    }
+
+    if (StopIfCancelled())
+        return;
+
+    WeldMap weldMap;
+    BuildWeldMap(positions, trianglesNumber * 3, weldMap, m_Cancelled);
+    if (StopIfCancelled())
+        return;
+
+    size_t verticesNumber = weldMap.sources.size();
+    Mesh mesh(verticesNumber);
+    GatherWeldedVertices(positions, weldMap, 0, verticesNumber, mesh.Positions());
+    mesh.SetIndices(std::move(weldMap.indices));
+
+    float* vertices = mesh.Positions();
+    uint32_t* indices = mesh.Indices();
+    size_t indicesNumber = mesh.IndicesNumber();
+    m_Progress = WELD_PROGRESS;
+
+    if (StopIfCancelled())
+        return;
+
+    // Every pass below may take seconds on a large model, so a new drop is never kept waiting for more than one
+    m_Result.cacheStatsBefore = AnalyzeVertexCache(indices, indicesNumber, verticesNumber, VERTEX_CACHE_SIZE);
+    if (StopIfCancelled())
+        return;
+
+    if (m_AssemblyPart)
+    {
+        // An assembly culls whole parts, so a part has no clusters; without them there is no overdraw order either
+        if (m_IndexOrder != IndexOrder::WELDED)
+        {
+            OptimizeVertexCache(indices, indicesNumber, verticesNumber, VERTEX_CACHE_SIZE);
+            if (StopIfCancelled())
+                return;
+
+            OptimizeVertexFetch(indices, indicesNumber, vertices, verticesNumber);
+        }
+    }
+    else
+    {
+        // The clusters come first, so the vertex cache order stays within each of them
+        m_Result.clusters = BuildClusters(vertices, indices, indicesNumber, m_IndexOrder == IndexOrder::VERTEX_CACHE_AND_OVERDRAW,
+            m_Cancelled);
+        if (StopIfCancelled())
+            return;
+
+        if (m_IndexOrder != IndexOrder::WELDED)
+        {
+            OptimizeClustersVertexCache(indices, m_Result.clusters, VERTEX_CACHE_SIZE, m_Cancelled);
+            if (StopIfCancelled())
+                return;
+
+            OptimizeVertexFetch(indices, indicesNumber, vertices, verticesNumber);
+        }
+    }
+
+    if (StopIfCancelled())
+        return;
+
+    m_Result.cacheStatsAfter = AnalyzeVertexCache(indices, indicesNumber, verticesNumber, VERTEX_CACHE_SIZE);
+    if (StopIfCancelled())
+        return;
+
+    m_Result.featureEdges = ExtractFeatureEdges(vertices, indices, indicesNumber, m_CreaseAngle, m_Cancelled);
+    if (StopIfCancelled())
+        return;
+
+    // Quantized positions are relative to the bounds of the whole model, only known now; float ones are stored as they are
+    std::vector<unsigned char> storedVertices;
+    if (m_VertexFormat != VertexFormat::FLOAT)
+    {
+        storedVertices.resize(verticesNumber * VertexSize(m_VertexFormat));
+        EncodePositions(vertices, verticesNumber, m_Result.bounds, m_VertexFormat, storedVertices.data());
+    }
+
+    if (StopIfCancelled())
+        return;
+
+    m_Progress = ORDER_PROGRESS;
+
+    m_VerticesNumber = verticesNumber;
+    m_WaitsForDestination = true;
+
+    glfwPostEmptyEvent();
+
+    void* destinationVertices;
+    uint32_t* destinationIndices;
+    {
+        std::unique_lock<std::mutex> lock(m_DestinationMutex);
+        m_DestinationCondition.wait(lock, [this] { return (m_DestinationVertices != nullptr) || m_Cancelled; });
+
+        destinationVertices = m_DestinationVertices;
+        destinationIndices = m_DestinationIndices;
+    }
+
+    if (StopIfCancelled())
+        return;
+
+    const void* sourceVertices = storedVertices.empty() ? static_cast<const void*>(vertices) : storedVertices.data();
+    std::memcpy(destinationVertices, sourceVertices, verticesNumber * VertexSize(m_VertexFormat));
+    std::memcpy(destinationIndices, indices, indicesNumber * sizeof(uint32_t));
+
+    // A part's triangles are not in the cluster order a cache holds
+    if (stamped && !m_AssemblyPart && (trianglesNumber >= CACHE_MIN_TRIANGLES))
+    {
+        m_Result.toCache = true;
+        m_Result.source = stamp;
+        m_Result.indexOrder = m_IndexOrder;
+        m_Result.creaseAngle = m_CreaseAngle;
+        m_Result.storedVertices = std::move(storedVertices);
+    }
+
+    m_Result.mesh = std::move(mesh);
+
+    m_Result.trianglesNumber = trianglesNumber;
+    m_Result.verticesNumber = verticesNumber;
+    Succeed(file.Size(), loadStart);
+}
+
+void LoadJob::SplitIntoChunks(const MappedFile& file, const StlSourceStamp& stamp, size_t trianglesNumber,
+    std::chrono::steady_clock::time_point loadStart)
+{
+    m_TrianglesNumber = trianglesNumber;
+
+    std::string chunksPath = StlChunksPath(m_Filepath);
+    auto chunks = std::make_unique<StlChunks>();
+
+    m_Result.fromCache = chunks->Open(chunksPath, stamp);
+    if (!m_Result.fromCache)
+    {
+        if (!BuildStlChunks(chunksPath, stamp, file.Data(), trianglesNumber, m_Cancelled, m_Progress, 0.0f, 1.0f) ||
+            !chunks->Open(chunksPath, stamp))
+        {
+            Fail(m_Cancelled ? std::string("Cancelled") : "Failed to write " + chunksPath);
+            return;
+        }
+    }
+
+    m_Result.trianglesNumber = trianglesNumber;
+    m_Result.bounds = chunks->Bounds();
+    m_Result.chunks = std::move(chunks);
+
+    Succeed(file.Size(), loadStart);
+}
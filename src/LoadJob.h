@@ -0,0 +1,161 @@
+#pragma once
+
+#include "FeatureEdges.h"
+#include "Mesh.h"
+#include "MeshClusters.h"
+#include "StlCache.h"
+#include "StlChunks.h"
+#include "StlLoader.h"
+#include "VertexCache.h"
+#include "VertexFormat.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class LoadState
+{
+    RUNNING, SUCCEEDED, FAILED, CANCELLED
+};
+
+// Model loaded by a LoadJob, handed over to the render thread for upload
+struct LoadedModel
+{
+    std::string filepath;
+
+    // The parsed triangle soup; empty when read from the cache
+    Mesh soup;
+
+    // Set when the model was read from its cache file, which stays mapped until it is uploaded and the jobs
+    // working on the welded mesh decoded it
+    std::shared_ptr<StlCache> cache;
+    bool fromCache{ false };
+
+    // Set for a model too large to load whole instead of any mesh; its chunk file stays mapped for streaming
+    // its chunks, and fromCache tells whether the file was there already
+    std::unique_ptr<StlChunks> chunks;
+
+    // The welded mesh, with 3 indices per triangle; quantized vertices are relative to bounds
+    size_t trianglesNumber{ 0 };
+    size_t verticesNumber{ 0 };
+    VertexFormat vertexFormat{ VertexFormat::FLOAT };
+    StlBounds bounds{ 0, 0, 0, 0, 0, 0 };
+
+    // The welded mesh with float positions, kept for the convex hull and the levels of detail; empty when read
+    // from the cache
+    Mesh mesh;
+
+    // Hierarchy over clusters of the welded mesh's triangles, which are ordered cluster by cluster
+    std::vector<ClusterNode> clusters;
+
+    // Lines along the boundaries, non-manifold edges and creases of the welded mesh
+    FeatureEdges featureEdges;
+
+    // Set for a parsed model large enough to be cached, whose cache a CacheJob writes once the model is shown,
+    // so its first display never waits for the disk; the cache is written for source, indexOrder and creaseAngle
+    bool toCache{ false };
+    StlSourceStamp source{};
+    IndexOrder indexOrder{ IndexOrder::WELDED };
+    float creaseAngle{ 0 };
+
+    // The welded positions in vertexFormat unless it is FLOAT, kept for the cache; float ones are the mesh's
+    std::vector<unsigned char> storedVertices;
+
+    // Vertex cache use of the welded index buffer before and after reordering; unknown for a cached model
+    VertexCacheStats cacheStatsBefore{ 0, 0 };
+    VertexCacheStats cacheStatsAfter{ 0, 0 };
+
+    size_t fileSize{ 0 };
+    double parseSeconds{ 0 };
+};
+
+// Loads an STL file on a background thread; the render thread polls it once per frame.
+// The file is parsed into a triangle soup in CPU memory, which the render thread can upload piecewise
+// while the job runs, then welded into an indexed mesh whose triangles are reordered as indexOrder asks,
+// then grouped into clusters for culling, and whose vertices are stored in vertexFormat. Edges turning by more than creaseAngle degrees are extracted
+// as feature edges.
+// The mesh is copied into memory the render thread hands over with SetDestination(), typically mapped GL buffers.
+// A model with a valid cache file is read from it instead, a large one parsed is marked for a CacheJob to write it.
+// A binary file with more than OUT_OF_CORE_MIN_TRIANGLES is only split into a chunk file, read from it later.
+// A part of an assembly gets no clusters and writes no cache. The job's passes use at most workers threads, all
+// hardware threads for 0.
+class LoadJob
+{
+public:
+    LoadJob(const std::string& filepath, IndexOrder indexOrder, VertexFormat vertexFormat, float creaseAngle, bool assemblyPart,
+        unsigned int workers);
+    ~LoadJob();
+
+    LoadJob(const LoadJob&) = delete;
+    LoadJob& operator=(const LoadJob&) = delete;
+
+    // Asks the thread to stop at the next batch; the destructor waits for it
+    void Cancel();
+
+    LoadState State() const { return m_State; }
+    float Progress() const { return m_Progress; }
+    const std::string& Filepath() const { return m_Filepath; }
+    const std::string& Error() const { return m_Error; }
+
+    // Known once the header or the ASCII count pass is read
+    size_t TrianglesNumber() const { return m_TrianglesNumber; }
+
+    // Triangles [0, TrianglesParsed()) of Positions() are final and can be uploaded while the job
+    // runs, ParsedBounds() are their bounds
+    const float* Positions() const { return m_Result.soup.Positions(); }
+    size_t TrianglesParsed() const { return m_TrianglesParsed; }
+    StlBounds ParsedBounds();
+
+    // Once the soup is welded the job waits for SetDestination(), which must hold VerticesNumber() vertices
+    // of VertexSize(vertexFormat) and TrianglesNumber() * 3 indices and stay valid until the job is destroyed
+    bool WaitsForDestination() const { return m_WaitsForDestination; }
+    size_t VerticesNumber() const { return m_VerticesNumber; }
+    VertexFormat VerticesFormat() const { return m_VertexFormat; }
+    void SetDestination(void* vertices, uint32_t* indices);
+
+    // Valid once State() is SUCCEEDED
+    LoadedModel& Result() { return m_Result; }
+
+private:
+    void Run();
+    void SplitIntoChunks(const MappedFile& file, const StlSourceStamp& stamp, size_t trianglesNumber,
+        std::chrono::steady_clock::time_point loadStart);
+    void Fail(const std::string& error);
+
+    // Fails the job as cancelled if it was asked to stop
+    bool StopIfCancelled();
+    void Publish(size_t trianglesParsed, const StlBounds& batchBounds);
+    void Succeed(size_t fileSize, std::chrono::steady_clock::time_point loadStart);
+
+    std::string m_Filepath;
+    IndexOrder m_IndexOrder;
+    VertexFormat m_VertexFormat;
+    float m_CreaseAngle;
+    bool m_AssemblyPart;
+    unsigned int m_Workers;
+    std::string m_Error;
+    LoadedModel m_Result;
+
+    void* m_DestinationVertices{ nullptr };
+    uint32_t* m_DestinationIndices{ nullptr };
+    std::atomic<bool> m_WaitsForDestination{ false };
+    std::mutex m_DestinationMutex;
+    std::condition_variable m_DestinationCondition;
+
+    std::atomic<LoadState> m_State{ LoadState::RUNNING };
+    std::atomic<float> m_Progress{ 0.0f };
+    std::atomic<bool> m_Cancelled{ false };
+
+    std::atomic<size_t> m_TrianglesNumber{ 0 };
+    std::atomic<size_t> m_TrianglesParsed{ 0 };
+    std::atomic<size_t> m_VerticesNumber{ 0 };
+    std::mutex m_BoundsMutex;
+
+    std::thread m_Thread;
+};
@@ -0,0 +1,82 @@
+#include "LodJob.h"
+
+#include "MeshSimplify.h"
+#include "VertexCache.h"
+
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+
+// Every level keeps about this share of the triangles of the one before
+const size_t LOD_REDUCTION{ 4 };
+
+// The chain stops before a level would get fewer triangles
+const size_t LOD_MIN_TRIANGLES{ 1 << 15 };
+
+// Or once seams and boundaries keep a level from shrinking below this share of the one before
+const float LOD_MAX_SHARE{ 0.75f };
+
+LodJob::LodJob(std::shared_ptr<const Mesh> mesh, VertexFormat vertexFormat, const StlBounds& bounds, float creaseAngle)
+    : m_Mesh(std::move(mesh)), m_VertexFormat(vertexFormat), m_Bounds(bounds), m_CreaseAngle(creaseAngle)
+{
+    m_Thread = std::thread(&LodJob::Run, this);
+}
+
+LodJob::LodJob(std::shared_ptr<const StlCache> cache, VertexFormat vertexFormat, const StlBounds& bounds, float creaseAngle)
+    : m_Cache(std::move(cache)), m_VertexFormat(vertexFormat), m_Bounds(bounds), m_CreaseAngle(creaseAngle)
+{
+    m_Thread = std::thread(&LodJob::Run, this);
+}
+
+LodJob::~LodJob()
+{
+    m_Cancelled = true;
+    m_Thread.join();
+}
+
+void LodJob::Run()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    if (m_Cache)
+    {
+        m_Mesh = std::make_shared<const Mesh>(m_Cache->DecodeMesh(true));
+        m_Cache.reset();
+    }
+
+    for (unsigned int pass = 0; !m_Cancelled; pass++)
+    {
+        const Mesh& source = m_Levels.empty() ? *m_Mesh : m_Levels.back().mesh;
+
+        size_t targetTrianglesNumber = source.TrianglesNumber() / LOD_REDUCTION;
+        if (targetTrianglesNumber < LOD_MIN_TRIANGLES)
+            break;
+
+        Mesh simplified = SimplifyMesh(source, targetTrianglesNumber, pass, m_Cancelled);
+        if (simplified.Empty() || (simplified.TrianglesNumber() > source.TrianglesNumber() * LOD_MAX_SHARE))
+            break;
+
+        uint32_t* indices = simplified.Indices();
+        size_t indicesNumber = simplified.IndicesNumber();
+        size_t verticesNumber = simplified.VerticesNumber();
+
+        OptimizeVertexCache(indices, indicesNumber, verticesNumber, VERTEX_CACHE_SIZE);
+        OptimizeVertexFetch(indices, indicesNumber, simplified.Positions(), verticesNumber);
+
+        LodLevel level;
+        level.vertices.resize(verticesNumber * VertexSize(m_VertexFormat));
+        EncodePositions(simplified.Positions(), verticesNumber, m_Bounds, m_VertexFormat, level.vertices.data());
+        level.featureEdges = ExtractFeatureEdges(simplified.Positions(), indices, indicesNumber, m_CreaseAngle, m_Cancelled);
+        level.mesh = std::move(simplified);
+
+        m_Levels.push_back(std::move(level));
+    }
+
+    m_Mesh.reset();
+
+    m_Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m_Done = true;
+
+    // Wake up the render loop if it waits for events
+    glfwPostEmptyEvent();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "FeatureEdges.h"
+#include "Mesh.h"
+#include "StlCache.h"
+#include "StlLoader.h"
+#include "VertexFormat.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// One simplified level of a model, ready for upload
+struct LodLevel
+{
+    // Positions as floats, with 3 indices per triangle ordered for the vertex cache
+    Mesh mesh;
+
+    // The positions in the model's vertex format, relative to its bounds when quantized
+    std::vector<unsigned char> vertices;
+
+    FeatureEdges featureEdges;
+};
+
+// Builds a chain of ever coarser levels of detail of a welded model on a background thread once it is loaded,
+// every level from the one before with about a quarter of its triangles, down to a few ten thousand.
+// The render thread polls it once per frame.
+class LodJob
+{
+public:
+    LodJob(std::shared_ptr<const Mesh> mesh, VertexFormat vertexFormat, const StlBounds& bounds, float creaseAngle);
+
+    // For a model read from its cache, whose positions and indices the job decodes first
+    LodJob(std::shared_ptr<const StlCache> cache, VertexFormat vertexFormat, const StlBounds& bounds, float creaseAngle);
+    ~LodJob();
+
+    LodJob(const LodJob&) = delete;
+    LodJob& operator=(const LodJob&) = delete;
+
+    bool Done() const { return m_Done; }
+
+    // Valid once Done(), from the finest level to the coarsest; none for a model too small to simplify
+    std::vector<LodLevel>& Levels() { return m_Levels; }
+    VertexFormat VerticesFormat() const { return m_VertexFormat; }
+    double Seconds() const { return m_Seconds; }
+
+private:
+    void Run();
+
+    std::shared_ptr<const Mesh> m_Mesh;
+    std::shared_ptr<const StlCache> m_Cache;
+    VertexFormat m_VertexFormat;
+    StlBounds m_Bounds;
+    float m_CreaseAngle;
+
+    std::vector<LodLevel> m_Levels;
+    double m_Seconds{ 0 };
+
+    std::atomic<bool> m_Done{ false };
+    std::atomic<bool> m_Cancelled{ false };
+
+    std::thread m_Thread;
+};
@@ -0,0 +1,32 @@
+#include "Mesh.h"
+
+#include "Parallel.h"
+
+const size_t MIN_VERTICES_PER_WORKER{ 1 << 16 };
+
+Mesh::Mesh(size_t verticesNumber)
+    : m_Positions(verticesNumber * 3)
+{
+}
+
+void Mesh::SplitPositions()
+{
+    size_t verticesNumber = VerticesNumber();
+    for (int axis = 0; axis < 3; axis++)
+        m_Components[axis] = AlignedArray<float>(verticesNumber);
+
+    const float* positions = m_Positions.Data();
+    float* x = m_Components[0].Data();
+    float* y = m_Components[1].Data();
+    float* z = m_Components[2].Data();
+
+    ParallelFor(verticesNumber, MIN_VERTICES_PER_WORKER, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        for (size_t vertex = begin; vertex < end; vertex++)
+        {
+            x[vertex] = positions[vertex * 3];
+            y[vertex] = positions[vertex * 3 + 1];
+            z[vertex] = positions[vertex * 3 + 2];
+        }
+    });
+}
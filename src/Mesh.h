@@ -0,0 +1,52 @@
+#pragma once
+
+#include "AlignedArray.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Triangle mesh owning ARRAY_ALIGNMENT-aligned arrays: positions, and optionally indices (3 per triangle;
+// without them every 3 vertices make a triangle, as in a soup). The normals and attribute words of the STL
+// records are not kept: the normals are recomputed from the positions where needed.
+// Positions() interleaves the coordinates as the GL buffers take them. SplitPositions() adds one array per
+// coordinate, which SIMD passes fill registers from without shuffling.
+class Mesh
+{
+public:
+    Mesh() = default;
+
+    // verticesNumber uninitialised positions
+    explicit Mesh(size_t verticesNumber);
+
+    Mesh(Mesh&&) noexcept = default;
+    Mesh& operator=(Mesh&&) noexcept = default;
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    bool Empty() const { return m_Positions.Empty(); }
+    size_t VerticesNumber() const { return m_Positions.Size() / 3; }
+    size_t TrianglesNumber() const { return IsIndexed() ? m_Indices.Size() / 3 : VerticesNumber() / 3; }
+
+    // 3 floats per vertex
+    float* Positions() { return m_Positions.Data(); }
+    const float* Positions() const { return m_Positions.Data(); }
+
+    bool IsIndexed() const { return !m_Indices.Empty(); }
+    uint32_t* Indices() { return m_Indices.Data(); }
+    const uint32_t* Indices() const { return m_Indices.Data(); }
+    size_t IndicesNumber() const { return m_Indices.Size(); }
+    void SetIndices(AlignedArray<uint32_t> indices) { m_Indices = std::move(indices); }
+    void ReleaseIndices() { m_Indices.Release(); }
+
+    // Copies the positions to one array per coordinate, in parallel; positions changed later need another split
+    void SplitPositions();
+    bool IsSplit() const { return !m_Components[0].Empty(); }
+
+    // Coordinate axis of every vertex, once split
+    const float* Component(int axis) const { return m_Components[axis].Data(); }
+
+private:
+    AlignedArray<float> m_Positions;
+    AlignedArray<uint32_t> m_Indices;
+    AlignedArray<float> m_Components[3];
+};
@@ -0,0 +1,416 @@
+#include "MeshClusters.h"
+
+#include "Parallel.h"
+#include "VertexCache.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+const size_t MIN_TRIANGLES_PER_WORKER{ 1 << 15 };
+const size_t MIN_CLUSTERS_PER_WORKER{ 1 << 8 };
+
+// Centroids are snapped to a grid of this many cells per axis across their bounds for the Morton order
+const uint32_t MORTON_CELLS{ 1 << 10 };
+
+// Moves the 10 low bits of value to every third bit
+static uint32_t SpreadBits(uint32_t value)
+{
+    value &= 0x3ff;
+    value = (value | (value << 16)) & 0x030000ff;
+    value = (value | (value << 8)) & 0x0300f00f;
+    value = (value | (value << 4)) & 0x030c30c3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+}
+
+// A node while the hierarchy is built, over triangles [begin, end) in Morton order, with the sums that order its children
+struct BuildNode
+{
+    float min[3];
+    float max[3];
+    size_t begin;
+    size_t end;
+    uint32_t children[2];
+
+    // Centroids and normals of the triangles weighted by their area, and the area
+    double centroid[3];
+    double normal[3];
+    double area;
+};
+
+// Splits triangles[begin, end) in two until the parts fit in clusters and returns the index of the node over them.
+// Every cluster's triangles are sorted back into the order they had in the index buffer. Stops splitting once cancelled is set
+static uint32_t SplitNode(const float* vertices, const uint32_t* indices, uint32_t* triangles, size_t begin, size_t end,
+    std::vector<BuildNode>& built, const std::atomic<bool>& cancelled)
+{
+    uint32_t index = (uint32_t)built.size();
+    built.push_back(BuildNode{ { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX }, begin, end, { 0, 0 },
+        { 0, 0, 0 }, { 0, 0, 0 }, 0 });
+
+    size_t trianglesNumber = end - begin;
+    if (trianglesNumber <= CLUSTER_TRIANGLES)
+    {
+        std::sort(triangles + begin, triangles + end);
+
+        BuildNode& node = built[index];
+        for (size_t triangle = begin; triangle < end; triangle++)
+        {
+            const float* corners[3];
+            for (int corner = 0; corner < 3; corner++)
+            {
+                corners[corner] = vertices + (size_t)indices[(size_t)triangles[triangle] * 3 + corner] * 3;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    node.min[axis] = std::min(node.min[axis], corners[corner][axis]);
+                    node.max[axis] = std::max(node.max[axis], corners[corner][axis]);
+                }
+            }
+
+            const float* a = corners[0];
+            const float* b = corners[1];
+            const float* c = corners[2];
+
+            double ab[3]{ b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            double ac[3]{ c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+            double cross[3]{ ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0] };
+            double area = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                node.centroid[axis] += (a[axis] + b[axis] + c[axis]) / 3.0 * area;
+                node.normal[axis] += cross[axis];
+            }
+            node.area += area;
+        }
+    }
+    else if (!cancelled)
+    {
+        // Both halves get about the same number of clusters
+        size_t clustersNumber = (trianglesNumber + CLUSTER_TRIANGLES - 1) / CLUSTER_TRIANGLES;
+        size_t middle = begin + trianglesNumber * (clustersNumber / 2) / clustersNumber;
+
+        uint32_t first = SplitNode(vertices, indices, triangles, begin, middle, built, cancelled);
+        uint32_t second = SplitNode(vertices, indices, triangles, middle, end, built, cancelled);
+
+        BuildNode& node = built[index];
+        node.children[0] = first;
+        node.children[1] = second;
+
+        for (uint32_t child : node.children)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                node.min[axis] = std::min(node.min[axis], built[child].min[axis]);
+                node.max[axis] = std::max(node.max[axis], built[child].max[axis]);
+                node.centroid[axis] += built[child].centroid[axis];
+                node.normal[axis] += built[child].normal[axis];
+            }
+            node.area += built[child].area;
+        }
+    }
+
+    return index;
+}
+
+// How far the node's triangles face away from centre: their mean normal along the way from centre to their mean centroid
+static double FacingKey(const BuildNode& node, const double centre[3])
+{
+    double normalLength = std::sqrt(node.normal[0] * node.normal[0] + node.normal[1] * node.normal[1] + node.normal[2] * node.normal[2]);
+    if ((node.area == 0) || (normalLength == 0))
+        return 0;
+
+    double key{ 0 };
+    for (int axis = 0; axis < 3; axis++)
+        key += (node.centroid[axis] / node.area - centre[axis]) * node.normal[axis] / normalLength;
+
+    return key;
+}
+
+// Appends the built node's subtree depth first to nodes and its triangles to order
+static void EmitNode(const std::vector<BuildNode>& built, uint32_t index, const uint32_t* triangles, bool facingOrder,
+    const double centre[3], std::vector<uint32_t>& order, std::vector<ClusterNode>& nodes)
+{
+    const BuildNode& node = built[index];
+
+    uint32_t emitted = (uint32_t)nodes.size();
+    nodes.push_back(ClusterNode{ { node.min[0], node.min[1], node.min[2] }, { node.max[0], node.max[1], node.max[2] },
+        (uint32_t)order.size(), (uint32_t)(node.end - node.begin), 0 });
+
+    if (node.end - node.begin <= CLUSTER_TRIANGLES)
+    {
+        order.insert(order.end(), triangles + node.begin, triangles + node.end);
+    }
+    else
+    {
+        uint32_t first = node.children[0];
+        uint32_t second = node.children[1];
+        if (facingOrder && (FacingKey(built[second], centre) > FacingKey(built[first], centre)))
+            std::swap(first, second);
+
+        EmitNode(built, first, triangles, facingOrder, centre, order, nodes);
+        EmitNode(built, second, triangles, facingOrder, centre, order, nodes);
+    }
+
+    nodes[emitted].skip = (uint32_t)nodes.size();
+}
+
+std::vector<ClusterNode> BuildClusters(const float* vertices, uint32_t* indices, size_t indicesNumber, bool facingOrder,
+    const std::atomic<bool>& cancelled)
+{
+    size_t trianglesNumber = indicesNumber / 3;
+    if (trianglesNumber == 0)
+        return std::vector<ClusterNode>();
+
+    std::vector<float> centroids(trianglesNumber * 3);
+    float minCentroid[3]{ FLT_MAX, FLT_MAX, FLT_MAX };
+    float maxCentroid[3]{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    for (size_t triangle = 0; triangle < trianglesNumber; triangle++)
+    {
+        const float* a = vertices + (size_t)indices[triangle * 3] * 3;
+        const float* b = vertices + (size_t)indices[triangle * 3 + 1] * 3;
+        const float* c = vertices + (size_t)indices[triangle * 3 + 2] * 3;
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float centroid = (a[axis] + b[axis] + c[axis]) / 3.0f;
+            centroids[triangle * 3 + axis] = centroid;
+            minCentroid[axis] = std::min(minCentroid[axis], centroid);
+            maxCentroid[axis] = std::max(maxCentroid[axis], centroid);
+        }
+    }
+
+    float cellsPerUnit[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float extent = maxCentroid[axis] - minCentroid[axis];
+        cellsPerUnit[axis] = (extent > 0.0f) ? (MORTON_CELLS - 1) / extent : 0.0f;
+    }
+
+    // The Morton code above the triangle, so ties keep the index buffer's order
+    std::vector<uint64_t> keys(trianglesNumber);
+    ParallelFor(trianglesNumber, MIN_TRIANGLES_PER_WORKER, [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t triangle = begin; triangle < end; triangle++)
+        {
+            uint32_t code{ 0 };
+            for (int axis = 0; axis < 3; axis++)
+            {
+                uint32_t cell = (uint32_t)((centroids[triangle * 3 + axis] - minCentroid[axis]) * cellsPerUnit[axis]);
+                code |= SpreadBits(std::min(cell, MORTON_CELLS - 1)) << axis;
+            }
+            keys[triangle] = ((uint64_t)code << 32) | triangle;
+        }
+    });
+
+    if (cancelled)
+        return std::vector<ClusterNode>();
+
+    std::sort(keys.begin(), keys.end());
+
+    if (cancelled)
+        return std::vector<ClusterNode>();
+
+    std::vector<uint32_t> triangles(trianglesNumber);
+    for (size_t triangle = 0; triangle < trianglesNumber; triangle++)
+        triangles[triangle] = (uint32_t)keys[triangle];
+
+    std::vector<BuildNode> built;
+    built.reserve(2 * (trianglesNumber / (CLUSTER_TRIANGLES / 2)) + 1);
+    SplitNode(vertices, indices, triangles.data(), 0, trianglesNumber, built, cancelled);
+
+    if (cancelled)
+        return std::vector<ClusterNode>();
+
+    double centre[3]{ 0, 0, 0 };
+    if (built[0].area > 0)
+        for (int axis = 0; axis < 3; axis++)
+            centre[axis] = built[0].centroid[axis] / built[0].area;
+
+    std::vector<uint32_t> order;
+    order.reserve(trianglesNumber);
+    std::vector<ClusterNode> nodes;
+    nodes.reserve(built.size());
+    EmitNode(built, 0, triangles.data(), facingOrder, centre, order, nodes);
+
+    std::vector<uint32_t> ordered(indicesNumber);
+    ParallelFor(trianglesNumber, MIN_TRIANGLES_PER_WORKER, [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t triangle = begin; triangle < end; triangle++)
+            std::memcpy(&ordered[triangle * 3], &indices[(size_t)order[triangle] * 3], 3 * sizeof(uint32_t));
+    });
+    std::memcpy(indices, ordered.data(), indicesNumber * sizeof(uint32_t));
+
+    return nodes;
+}
+
+std::vector<ClusterNode> ClusterLeaves(const std::vector<ClusterNode>& nodes)
+{
+    std::vector<ClusterNode> leaves;
+    for (size_t node = 0; node < nodes.size(); node++)
+        if (nodes[node].skip == node + 1)
+            leaves.push_back(nodes[node]);
+
+    return leaves;
+}
+
+static uint32_t HashVertex(uint32_t vertex)
+{
+    uint64_t hash = vertex * 0x9E3779B97F4A7C15ull;
+
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+static size_t TableSize(size_t entries)
+{
+    size_t size{ 16 };
+    while (size <= entries)
+        size *= 2;
+    return size;
+}
+
+void OptimizeClustersVertexCache(uint32_t* indices, const std::vector<ClusterNode>& nodes, unsigned int cacheSize,
+    const std::atomic<bool>& cancelled)
+{
+    std::vector<ClusterNode> leaves = ClusterLeaves(nodes);
+
+    ParallelFor(leaves.size(), MIN_CLUSTERS_PER_WORKER, [&](size_t begin, size_t end, unsigned int)
+    {
+        // The cluster's vertices, numbered from 0 in the order it first uses them, through an open-addressed table
+        // sized for the cluster rather than the mesh
+        struct VertexSlot
+        {
+            uint32_t vertex;
+            uint32_t local;
+        };
+        const uint32_t EMPTY_SLOT{ UINT32_MAX };
+        std::vector<VertexSlot> table;
+        std::vector<uint32_t> vertices;
+        std::vector<uint32_t> localIndices;
+
+        for (size_t leaf = begin; (leaf < end) && !cancelled; leaf++)
+        {
+            const ClusterNode& node = leaves[leaf];
+            uint32_t* clusterIndices = indices + (size_t)node.firstTriangle * 3;
+            size_t indicesNumber = (size_t)node.trianglesNumber * 3;
+
+            table.assign(TableSize(indicesNumber), VertexSlot{ EMPTY_SLOT, 0 });
+            size_t mask = table.size() - 1;
+
+            vertices.clear();
+            localIndices.resize(indicesNumber);
+            for (size_t index = 0; index < indicesNumber; index++)
+            {
+                uint32_t vertex = clusterIndices[index];
+
+                size_t slot = HashVertex(vertex) & mask;
+                while ((table[slot].vertex != EMPTY_SLOT) && (table[slot].vertex != vertex))
+                    slot = (slot + 1) & mask;
+
+                if (table[slot].vertex == EMPTY_SLOT)
+                {
+                    table[slot] = VertexSlot{ vertex, (uint32_t)vertices.size() };
+                    vertices.push_back(vertex);
+                }
+                localIndices[index] = table[slot].local;
+            }
+
+            OptimizeVertexCache(localIndices.data(), indicesNumber, vertices.size(), cacheSize);
+
+            for (size_t index = 0; index < indicesNumber; index++)
+                clusterIndices[index] = vertices[localIndices[index]];
+        }
+    });
+}
+
+// Planes a x + b y + c z + d >= 0 around the view volume -w <= x, y, z <= w of clip = matrix * (x, y, z, 1)
+// (Gribb and Hartmann 2001)
+static void ViewPlanes(const float matrix[16], float planes[6][4])
+{
+    for (int axis = 0; axis < 3; axis++)
+        for (int column = 0; column < 4; column++)
+        {
+            float w = matrix[column * 4 + 3];
+            float coordinate = matrix[column * 4 + axis];
+            planes[axis * 2][column] = w + coordinate;
+            planes[axis * 2 + 1][column] = w - coordinate;
+        }
+}
+
+static void AppendRange(std::vector<TriangleRange>& ranges, uint32_t first, uint32_t number)
+{
+    if (!ranges.empty() && (ranges.back().first + ranges.back().number == first))
+        ranges.back().number += number;
+    else
+        ranges.push_back(TriangleRange{ first, number });
+}
+
+// planesMask holds the planes the node's parent is not entirely inside of
+static void CullNode(const std::vector<ClusterNode>& nodes, uint32_t index, const float planes[6][4], unsigned int planesMask,
+    std::vector<TriangleRange>& ranges)
+{
+    const ClusterNode& node = nodes[index];
+
+    for (int plane = 0; plane < 6; plane++)
+    {
+        if ((planesMask & (1u << plane)) == 0)
+            continue;
+
+        // The corners of the bounds furthest along the plane's normal and against it
+        const float* p = planes[plane];
+        float furthest = p[3];
+        float nearest = p[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            furthest += p[axis] * ((p[axis] >= 0.0f) ? node.max[axis] : node.min[axis]);
+            nearest += p[axis] * ((p[axis] >= 0.0f) ? node.min[axis] : node.max[axis]);
+        }
+
+        if (furthest < 0.0f)
+            return;
+        if (nearest >= 0.0f)
+            planesMask &= ~(1u << plane);
+    }
+
+    bool leaf = (node.skip == index + 1);
+    if (leaf || (planesMask == 0))
+    {
+        AppendRange(ranges, node.firstTriangle, node.trianglesNumber);
+        return;
+    }
+
+    CullNode(nodes, index + 1, planes, planesMask, ranges);
+    CullNode(nodes, nodes[index + 1].skip, planes, planesMask, ranges);
+}
+
+void CullClusters(const std::vector<ClusterNode>& nodes, const float matrix[16], std::vector<TriangleRange>& ranges)
+{
+    ranges.clear();
+    if (nodes.empty())
+        return;
+
+    float planes[6][4];
+    ViewPlanes(matrix, planes);
+
+    CullNode(nodes, 0, planes, (1u << 6) - 1, ranges);
+}
+
+bool BoxMayBeInView(const float min[3], const float max[3], const float matrix[16])
+{
+    float planes[6][4];
+    ViewPlanes(matrix, planes);
+
+    for (const float* p : planes)
+    {
+        float furthest = p[3];
+        for (int axis = 0; axis < 3; axis++)
+            furthest += p[axis] * ((p[axis] >= 0.0f) ? max[axis] : min[axis]);
+
+        if (furthest < 0.0f)
+            return false;
+    }
+
+    return true;
+}
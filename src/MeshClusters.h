@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Triangles per cluster at most; a cluster holds at least half as many unless the mesh is smaller
+const size_t CLUSTER_TRIANGLES{ 512 };
+
+// Node of a bounding volume hierarchy over the clusters of a mesh whose triangles are ordered so that every node
+// covers a contiguous range of them. Nodes are stored depth first: an inner node's first child follows it,
+// its second child starts at the first child's skip, and its own skip is the node after its subtree.
+// The layout is stored in the model cache as it is.
+struct ClusterNode
+{
+    float min[3];
+    float max[3];
+    uint32_t firstTriangle;
+    uint32_t trianglesNumber;
+    uint32_t skip;
+};
+
+// Triangles [first, first + number) of the index buffer
+struct TriangleRange
+{
+    uint32_t first;
+    uint32_t number;
+};
+
+// Splits the triangles into spatially coherent clusters along the Morton order of their centroids and reorders them
+// cluster by cluster; within a cluster the triangles keep their order. Returns the hierarchy, whose leaves are the clusters.
+// With facingOrder, of the two children of every node the one whose triangles face away from the centre of the mesh
+// more comes first, so it tends to hide the other (the overdraw order of Sander, Nehab and Barczak 2007, taken
+// to the hierarchy). Once cancelled is set, returns no clusters and may leave the triangles in their order.
+std::vector<ClusterNode> BuildClusters(const float* vertices, uint32_t* indices, size_t indicesNumber, bool facingOrder,
+    const std::atomic<bool>& cancelled);
+
+// The clusters alone, in the order of their triangles
+std::vector<ClusterNode> ClusterLeaves(const std::vector<ClusterNode>& nodes);
+
+// Reorders the triangles of every cluster for the vertex cache on their own, so they stay in their cluster;
+// stops between two clusters once cancelled is set
+void OptimizeClustersVertexCache(uint32_t* indices, const std::vector<ClusterNode>& nodes, unsigned int cacheSize,
+    const std::atomic<bool>& cancelled);
+
+// Replaces ranges with the triangles of the clusters whose bounds may be inside the view volume of
+// clip = matrix * (x, y, z, 1), matrix column-major as GL takes it. Neighbouring clusters share one range,
+// and a node entirely inside is taken whole without visiting its subtree.
+void CullClusters(const std::vector<ClusterNode>& nodes, const float matrix[16], std::vector<TriangleRange>& ranges);
+
+// Whether the box [min, max] may reach into the view volume of clip = matrix * (x, y, z, 1)
+bool BoxMayBeInView(const float min[3], const float max[3], const float matrix[16]);
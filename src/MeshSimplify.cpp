@@ -0,0 +1,675 @@
+#include "MeshSimplify.h"
+
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+const size_t MIN_TRIANGLES_PER_WORKER{ 1 << 15 };
+
+// Partitions hold about this many triangles, enough that few of their vertices are on seams
+const size_t TRIANGLES_PER_PARTITION{ 1 << 17 };
+
+// Boundary planes outweigh the surface ones, so open edges keep their place
+const double BOUNDARY_WEIGHT{ 100.0 };
+
+// No collapse may turn a remaining triangle by more than about 75 degrees
+const double MIN_NORMAL_COSINE{ 0.25 };
+
+// The optimal position of an edge is only taken this many edge lengths from its middle, further ones are
+// the planes barely pinning it down
+const double MAX_OPTIMAL_DISTANCE{ 2.0 };
+
+// Partition of every vertex: none until a triangle uses it, shared once triangles of several do
+const uint32_t NO_PARTITION{ UINT32_MAX };
+const uint32_t SHARED_VERTEX{ UINT32_MAX - 1 };
+
+// Sum of the squared distances to weighted planes, the upper triangle of a symmetric 4x4 matrix
+struct Quadric
+{
+    double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+};
+
+// Plane of the points p with normal . p + offset = 0
+static void AddPlane(Quadric& q, const double normal[3], double offset, double weight)
+{
+    double a = normal[0], b = normal[1], c = normal[2], d = offset;
+
+    q.xx += weight * a * a; q.xy += weight * a * b; q.xz += weight * a * c; q.xw += weight * a * d;
+    q.yy += weight * b * b; q.yz += weight * b * c; q.yw += weight * b * d;
+    q.zz += weight * c * c; q.zw += weight * c * d;
+    q.ww += weight * d * d;
+}
+
+static void AddQuadric(Quadric& q, const Quadric& other)
+{
+    q.xx += other.xx; q.xy += other.xy; q.xz += other.xz; q.xw += other.xw;
+    q.yy += other.yy; q.yz += other.yz; q.yw += other.yw;
+    q.zz += other.zz; q.zw += other.zw;
+    q.ww += other.ww;
+}
+
+static double QuadricError(const Quadric& q, const double p[3])
+{
+    double x = p[0], y = p[1], z = p[2];
+
+    double error = q.xx * x * x + q.yy * y * y + q.zz * z * z + q.ww +
+        2.0 * (q.xy * x * y + q.xz * x * z + q.yz * y * z + q.xw * x + q.yw * y + q.zw * z);
+
+    // Rounding can take a sum of squares a little below 0
+    return std::max(0.0, error);
+}
+
+// Position of the smallest error, false when the planes do not pin one down
+static bool OptimalPosition(const Quadric& q, double p[3])
+{
+    double a = q.xx, b = q.xy, c = q.xz, d = q.yy, e = q.yz, f = q.zz;
+
+    // Cofactors of the symmetric 3x3 part
+    double i00 = d * f - e * e, i01 = c * e - b * f, i02 = b * e - c * d;
+    double i11 = a * f - c * c, i12 = b * c - a * e, i22 = a * d - b * b;
+
+    double determinant = a * i00 + b * i01 + c * i02;
+    double trace = a + d + f;
+
+    if (!(std::abs(determinant) > 1e-12 * trace * trace * trace))
+        return false;
+
+    p[0] = -(i00 * q.xw + i01 * q.yw + i02 * q.zw) / determinant;
+    p[1] = -(i01 * q.xw + i11 * q.yw + i12 * q.zw) / determinant;
+    p[2] = -(i02 * q.xw + i12 * q.yw + i22 * q.zw) / determinant;
+    return true;
+}
+
+static void Cross(const double u[3], const double v[3], double n[3])
+{
+    n[0] = u[1] * v[2] - u[2] * v[1];
+    n[1] = u[2] * v[0] - u[0] * v[2];
+    n[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+static double Dot(const double u[3], const double v[3])
+{
+    return u[0] * v[0] + u[1] * v[1] + u[2] * v[2];
+}
+
+// Moving vertex from onto vertex to, which takes position; ordered by error for the queue
+struct Collapse
+{
+    double error;
+    uint32_t from;
+    uint32_t to;
+    uint32_t fromVersion;
+    uint32_t toVersion;
+    double position[3];
+
+    bool operator>(const Collapse& other) const { return error > other.error; }
+};
+
+// Collapses the edges of one partition's triangles, cheapest first, leaving the vertices on its seams in place.
+// Vertices and triangles are numbered locally; a collapse bumps the version of the vertex it keeps, which
+// makes the queued collapses of that vertex stale.
+class PartitionSimplifier
+{
+public:
+    PartitionSimplifier(const float* positions, const uint32_t* indices, const uint32_t* triangles, size_t trianglesNumber,
+        const uint32_t* vertexPartitions);
+
+    void Simplify(size_t targetTrianglesNumber);
+
+    // Appends the remaining triangles with the mesh's vertex indices and writes the positions of the moved vertices
+    void Write(float* positions, std::vector<uint32_t>& indices) const;
+
+private:
+    const double* Position(uint32_t vertex) const { return &m_Positions[vertex * 3]; }
+    bool Contains(uint32_t triangle, uint32_t vertex) const;
+
+    void AddBoundaryPlanes(const std::vector<uint64_t>& edges);
+    void QueueCollapse(uint32_t a, uint32_t b);
+    bool CanCollapse(const Collapse& collapse);
+    bool KeepsOrientation(uint32_t moved, uint32_t other, const double position[3]);
+    void ApplyCollapse(const Collapse& collapse);
+
+    std::vector<uint32_t> m_Vertices;
+    std::vector<double> m_Positions;
+    std::vector<Quadric> m_Quadrics;
+    std::vector<uint8_t> m_Locked;
+    std::vector<uint8_t> m_Removed;
+    std::vector<uint32_t> m_Versions;
+    std::vector<std::vector<uint32_t>> m_VertexTriangles;
+
+    std::vector<uint32_t> m_Triangles;
+    std::vector<uint8_t> m_Alive;
+    size_t m_AliveNumber{ 0 };
+
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> m_Queue;
+
+    // Scratch of CanCollapse() and ApplyCollapse(), marking vertices with the current step
+    std::vector<uint32_t> m_MarkedAt;
+    std::vector<uint32_t> m_CountedAt;
+    uint32_t m_Step{ 0 };
+};
+
+PartitionSimplifier::PartitionSimplifier(const float* positions, const uint32_t* indices, const uint32_t* triangles, size_t trianglesNumber,
+    const uint32_t* vertexPartitions)
+{
+    m_Triangles.resize(trianglesNumber * 3);
+    for (size_t triangle = 0; triangle < trianglesNumber; triangle++)
+        for (int corner = 0; corner < 3; corner++)
+            m_Triangles[triangle * 3 + corner] = indices[(size_t)triangles[triangle] * 3 + corner];
+
+    m_Vertices = m_Triangles;
+    std::sort(m_Vertices.begin(), m_Vertices.end());
+    m_Vertices.erase(std::unique(m_Vertices.begin(), m_Vertices.end()), m_Vertices.end());
+
+    for (uint32_t& vertex : m_Triangles)
+        vertex = (uint32_t)(std::lower_bound(m_Vertices.begin(), m_Vertices.end(), vertex) - m_Vertices.begin());
+
+    size_t verticesNumber = m_Vertices.size();
+
+    m_Positions.resize(verticesNumber * 3);
+    m_Locked.resize(verticesNumber);
+    for (size_t vertex = 0; vertex < verticesNumber; vertex++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+            m_Positions[vertex * 3 + axis] = positions[(size_t)m_Vertices[vertex] * 3 + axis];
+        m_Locked[vertex] = (vertexPartitions[m_Vertices[vertex]] == SHARED_VERTEX);
+    }
+
+    m_Quadrics.assign(verticesNumber, Quadric{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 });
+    m_Removed.assign(verticesNumber, 0);
+    m_Versions.assign(verticesNumber, 0);
+    m_VertexTriangles.resize(verticesNumber);
+    m_MarkedAt.assign(verticesNumber, 0);
+    m_CountedAt.assign(verticesNumber, 0);
+
+    m_Alive.assign(trianglesNumber, 0);
+
+    // The edge of every half-edge, its smaller vertex in the high bits; sorted, each edge shows once per triangle on it
+    std::vector<uint64_t> edges;
+    edges.reserve(trianglesNumber * 3);
+
+    for (size_t triangle = 0; triangle < trianglesNumber; triangle++)
+    {
+        const uint32_t* corners = &m_Triangles[triangle * 3];
+
+        // Triangles using a vertex twice have no area to keep
+        if ((corners[0] == corners[1]) || (corners[1] == corners[2]) || (corners[2] == corners[0]))
+            continue;
+
+        m_Alive[triangle] = 1;
+        m_AliveNumber++;
+
+        const double* a = Position(corners[0]);
+        const double* b = Position(corners[1]);
+        const double* c = Position(corners[2]);
+
+        double u[3]{ b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        double v[3]{ c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        double normal[3];
+        Cross(u, v, normal);
+
+        double length = std::sqrt(Dot(normal, normal));
+        if (length > 0.0)
+        {
+            for (int axis = 0; axis < 3; axis++)
+                normal[axis] /= length;
+
+            // Weighted by area, so large triangles pull harder
+            for (int corner = 0; corner < 3; corner++)
+                AddPlane(m_Quadrics[corners[corner]], normal, -Dot(normal, a), length * 0.5);
+        }
+
+        for (int corner = 0; corner < 3; corner++)
+        {
+            m_VertexTriangles[corners[corner]].push_back((uint32_t)triangle);
+
+            uint32_t from = corners[corner], to = corners[(corner + 1) % 3];
+            edges.push_back((uint64_t)std::min(from, to) << 32 | std::max(from, to));
+        }
+    }
+
+    std::sort(edges.begin(), edges.end());
+    AddBoundaryPlanes(edges);
+
+    for (size_t edge = 0; edge < edges.size(); edge++)
+        if ((edge == 0) || (edges[edge] != edges[edge - 1]))
+            QueueCollapse((uint32_t)(edges[edge] >> 32), (uint32_t)edges[edge]);
+}
+
+bool PartitionSimplifier::Contains(uint32_t triangle, uint32_t vertex) const
+{
+    const uint32_t* corners = &m_Triangles[triangle * 3];
+    return (corners[0] == vertex) || (corners[1] == vertex) || (corners[2] == vertex);
+}
+
+// An edge of one triangle gets a plane through it, upright on the triangle; the vertices of an edge of
+// more than two are locked
+void PartitionSimplifier::AddBoundaryPlanes(const std::vector<uint64_t>& edges)
+{
+    for (size_t first = 0, last; first < edges.size(); first = last)
+    {
+        for (last = first + 1; (last < edges.size()) && (edges[last] == edges[first]); last++)
+        {
+        }
+
+        uint32_t a = (uint32_t)(edges[first] >> 32), b = (uint32_t)edges[first];
+
+        if (last - first > 2)
+        {
+            m_Locked[a] = 1;
+            m_Locked[b] = 1;
+            continue;
+        }
+
+        if ((last - first != 1) || (m_Locked[a] && m_Locked[b]))
+            continue;
+
+        for (uint32_t triangle : m_VertexTriangles[a])
+        {
+            if (!Contains(triangle, b))
+                continue;
+
+            const uint32_t* corners = &m_Triangles[triangle * 3];
+            const double* p0 = Position(corners[0]);
+            const double* p1 = Position(corners[1]);
+            const double* p2 = Position(corners[2]);
+
+            double u[3]{ p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            double v[3]{ p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            double normal[3];
+            Cross(u, v, normal);
+
+            const double* pa = Position(a);
+            const double* pb = Position(b);
+            double edge[3]{ pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+
+            double planeNormal[3];
+            Cross(edge, normal, planeNormal);
+
+            double length = std::sqrt(Dot(planeNormal, planeNormal));
+            if (length > 0.0)
+            {
+                for (int axis = 0; axis < 3; axis++)
+                    planeNormal[axis] /= length;
+
+                double weight = BOUNDARY_WEIGHT * Dot(edge, edge);
+                AddPlane(m_Quadrics[a], planeNormal, -Dot(planeNormal, pa), weight);
+                AddPlane(m_Quadrics[b], planeNormal, -Dot(planeNormal, pa), weight);
+            }
+            break;
+        }
+    }
+}
+
+// Queues the cheapest way to collapse edge ab: onto a locked end, or to the position of the smallest error,
+// or failing that to the better of the ends and the middle
+void PartitionSimplifier::QueueCollapse(uint32_t a, uint32_t b)
+{
+    if (m_Locked[a] && m_Locked[b])
+        return;
+
+    if (m_Locked[a])
+        std::swap(a, b);
+
+    // a moves, b stays
+    Quadric quadric = m_Quadrics[a];
+    AddQuadric(quadric, m_Quadrics[b]);
+
+    Collapse collapse;
+    collapse.from = a;
+    collapse.to = b;
+    collapse.fromVersion = m_Versions[a];
+    collapse.toVersion = m_Versions[b];
+
+    const double* pa = Position(a);
+    const double* pb = Position(b);
+
+    if (m_Locked[b])
+    {
+        std::copy(pb, pb + 3, collapse.position);
+        collapse.error = QuadricError(quadric, collapse.position);
+        m_Queue.push(collapse);
+        return;
+    }
+
+    double middle[3]{ (pa[0] + pb[0]) * 0.5, (pa[1] + pb[1]) * 0.5, (pa[2] + pb[2]) * 0.5 };
+    double edge[3]{ pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+
+    double optimal[3];
+    if (OptimalPosition(quadric, optimal))
+    {
+        double offset[3]{ optimal[0] - middle[0], optimal[1] - middle[1], optimal[2] - middle[2] };
+        if (Dot(offset, offset) <= MAX_OPTIMAL_DISTANCE * MAX_OPTIMAL_DISTANCE * Dot(edge, edge))
+        {
+            std::copy(optimal, optimal + 3, collapse.position);
+            collapse.error = QuadricError(quadric, collapse.position);
+            m_Queue.push(collapse);
+            return;
+        }
+    }
+
+    collapse.error = DBL_MAX;
+    for (const double* candidate : { pa, pb, (const double*)middle })
+    {
+        double error = QuadricError(quadric, candidate);
+        if (error < collapse.error)
+        {
+            collapse.error = error;
+            std::copy(candidate, candidate + 3, collapse.position);
+        }
+    }
+    m_Queue.push(collapse);
+}
+
+// Whether the triangles of moved, apart from those it shares with other, face the same way with moved at position
+bool PartitionSimplifier::KeepsOrientation(uint32_t moved, uint32_t other, const double position[3])
+{
+    for (uint32_t triangle : m_VertexTriangles[moved])
+    {
+        if (!m_Alive[triangle] || Contains(triangle, other))
+            continue;
+
+        const uint32_t* corners = &m_Triangles[triangle * 3];
+        const double* p[3]{ Position(corners[0]), Position(corners[1]), Position(corners[2]) };
+
+        double before[3], after[3];
+        double u[3]{ p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+        double v[3]{ p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+        Cross(u, v, before);
+
+        for (int corner = 0; corner < 3; corner++)
+            if (corners[corner] == moved)
+                p[corner] = position;
+
+        double s[3]{ p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+        double t[3]{ p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+        Cross(s, t, after);
+
+        double beforeSquared = Dot(before, before);
+        if (beforeSquared == 0.0)
+            continue;
+
+        double afterSquared = Dot(after, after);
+        double dot = Dot(before, after);
+
+        if ((afterSquared == 0.0) || (dot < MIN_NORMAL_COSINE * std::sqrt(beforeSquared * afterSquared)))
+            return false;
+    }
+
+    return true;
+}
+
+// A queued collapse still applies if neither end changed since; it must neither flip a triangle nor, by the
+// link condition, join the edge's ends through any vertex but the third ones of the triangles on the edge
+bool PartitionSimplifier::CanCollapse(const Collapse& collapse)
+{
+    uint32_t from = collapse.from, to = collapse.to;
+
+    if (m_Removed[from] || m_Removed[to] || (m_Versions[from] != collapse.fromVersion) || (m_Versions[to] != collapse.toVersion))
+        return false;
+
+    m_Step++;
+
+    for (uint32_t triangle : m_VertexTriangles[to])
+    {
+        if (!m_Alive[triangle])
+            continue;
+
+        for (int corner = 0; corner < 3; corner++)
+            m_MarkedAt[m_Triangles[triangle * 3 + corner]] = m_Step;
+    }
+
+    size_t shared{ 0 }, common{ 0 };
+    for (uint32_t triangle : m_VertexTriangles[from])
+    {
+        if (!m_Alive[triangle])
+            continue;
+
+        if (Contains(triangle, to))
+            shared++;
+
+        for (int corner = 0; corner < 3; corner++)
+        {
+            uint32_t vertex = m_Triangles[triangle * 3 + corner];
+            if ((vertex != from) && (vertex != to) && (m_MarkedAt[vertex] == m_Step) && (m_CountedAt[vertex] != m_Step))
+            {
+                m_CountedAt[vertex] = m_Step;
+                common++;
+            }
+        }
+    }
+
+    if ((shared == 0) || (common != shared))
+        return false;
+
+    return KeepsOrientation(from, to, collapse.position) && KeepsOrientation(to, from, collapse.position);
+}
+
+void PartitionSimplifier::ApplyCollapse(const Collapse& collapse)
+{
+    uint32_t from = collapse.from, to = collapse.to;
+
+    std::vector<uint32_t>& toTriangles = m_VertexTriangles[to];
+
+    for (uint32_t triangle : m_VertexTriangles[from])
+    {
+        if (!m_Alive[triangle])
+            continue;
+
+        if (Contains(triangle, to))
+        {
+            m_Alive[triangle] = 0;
+            m_AliveNumber--;
+            continue;
+        }
+
+        for (int corner = 0; corner < 3; corner++)
+            if (m_Triangles[triangle * 3 + corner] == from)
+                m_Triangles[triangle * 3 + corner] = to;
+
+        toTriangles.push_back(triangle);
+    }
+
+    m_VertexTriangles[from] = std::vector<uint32_t>();
+    m_Removed[from] = 1;
+
+    toTriangles.erase(std::remove_if(toTriangles.begin(), toTriangles.end(), [this](uint32_t triangle) { return !m_Alive[triangle]; }),
+        toTriangles.end());
+
+    std::copy(collapse.position, collapse.position + 3, &m_Positions[to * 3]);
+    AddQuadric(m_Quadrics[to], m_Quadrics[from]);
+    m_Versions[to]++;
+
+    m_Step++;
+    m_MarkedAt[to] = m_Step;
+
+    for (uint32_t triangle : toTriangles)
+    {
+        for (int corner = 0; corner < 3; corner++)
+        {
+            uint32_t vertex = m_Triangles[triangle * 3 + corner];
+            if (m_MarkedAt[vertex] != m_Step)
+            {
+                m_MarkedAt[vertex] = m_Step;
+                QueueCollapse(to, vertex);
+            }
+        }
+    }
+}
+
+void PartitionSimplifier::Simplify(size_t targetTrianglesNumber)
+{
+    while ((m_AliveNumber > targetTrianglesNumber) && !m_Queue.empty())
+    {
+        Collapse collapse = m_Queue.top();
+        m_Queue.pop();
+
+        if (CanCollapse(collapse))
+            ApplyCollapse(collapse);
+    }
+}
+
+void PartitionSimplifier::Write(float* positions, std::vector<uint32_t>& indices) const
+{
+    for (size_t triangle = 0; triangle < m_Alive.size(); triangle++)
+    {
+        if (!m_Alive[triangle])
+            continue;
+
+        for (int corner = 0; corner < 3; corner++)
+            indices.push_back(m_Vertices[m_Triangles[triangle * 3 + corner]]);
+    }
+
+    // Unlocked vertices belong to this partition alone
+    for (size_t vertex = 0; vertex < m_Vertices.size(); vertex++)
+    {
+        if (m_Locked[vertex] || m_Removed[vertex])
+            continue;
+
+        for (int axis = 0; axis < 3; axis++)
+            positions[(size_t)m_Vertices[vertex] * 3 + axis] = (float)m_Positions[vertex * 3 + axis];
+    }
+}
+
+Mesh SimplifyMesh(const Mesh& mesh, size_t targetTrianglesNumber, unsigned int pass, const std::atomic<bool>& cancelled)
+{
+    const float* positions = mesh.Positions();
+    const uint32_t* indices = mesh.Indices();
+    size_t verticesNumber = mesh.VerticesNumber();
+    size_t trianglesNumber = mesh.TrianglesNumber();
+
+    float minimum[3]{ FLT_MAX, FLT_MAX, FLT_MAX };
+    float maximum[3]{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    for (size_t vertex = 0; vertex < verticesNumber; vertex++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            minimum[axis] = std::min(minimum[axis], positions[vertex * 3 + axis]);
+            maximum[axis] = std::max(maximum[axis], positions[vertex * 3 + axis]);
+        }
+    }
+
+    // The grid has one cell more along every axis than it needs unshifted, which the shift fills
+    size_t cellsPerAxis = (size_t)std::ceil(std::cbrt((double)std::max<size_t>(1, trianglesNumber / TRIANGLES_PER_PARTITION)));
+    size_t gridSize = cellsPerAxis + 1;
+    float shift = (pass % 2 == 1) ? 0.5f : 0.0f;
+
+    std::vector<uint32_t> trianglePartitions(trianglesNumber);
+
+    ParallelFor(trianglesNumber, MIN_TRIANGLES_PER_WORKER, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        for (size_t triangle = begin; triangle < end; triangle++)
+        {
+            size_t partition{ 0 };
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float centre{ 0 };
+                for (int corner = 0; corner < 3; corner++)
+                    centre += positions[(size_t)indices[triangle * 3 + corner] * 3 + axis];
+                centre /= 3.0f;
+
+                float extent = maximum[axis] - minimum[axis];
+                float cell = (extent > 0.0f) ? (centre - minimum[axis]) / extent * cellsPerAxis + shift : 0.0f;
+
+                partition = partition * gridSize + std::min(gridSize - 1, (size_t)std::max(0.0f, cell));
+            }
+            trianglePartitions[triangle] = (uint32_t)partition;
+        }
+    });
+
+    size_t partitionsNumber = gridSize * gridSize * gridSize;
+    std::vector<size_t> partitionFirst(partitionsNumber + 1, 0);
+
+    for (uint32_t partition : trianglePartitions)
+        partitionFirst[partition + 1]++;
+    for (size_t partition = 0; partition < partitionsNumber; partition++)
+        partitionFirst[partition + 1] += partitionFirst[partition];
+
+    std::vector<uint32_t> partitionTriangles(trianglesNumber);
+    std::vector<uint32_t> vertexPartitions(verticesNumber, NO_PARTITION);
+    {
+        std::vector<size_t> next(partitionFirst.begin(), partitionFirst.end() - 1);
+
+        for (size_t triangle = 0; triangle < trianglesNumber; triangle++)
+        {
+            uint32_t partition = trianglePartitions[triangle];
+            partitionTriangles[next[partition]++] = (uint32_t)triangle;
+
+            for (int corner = 0; corner < 3; corner++)
+            {
+                uint32_t& vertexPartition = vertexPartitions[indices[triangle * 3 + corner]];
+                if (vertexPartition == NO_PARTITION)
+                    vertexPartition = partition;
+                else if (vertexPartition != partition)
+                    vertexPartition = SHARED_VERTEX;
+            }
+        }
+    }
+
+    std::vector<uint32_t> partitions;
+    for (size_t partition = 0; partition < partitionsNumber; partition++)
+        if (partitionFirst[partition + 1] > partitionFirst[partition])
+            partitions.push_back((uint32_t)partition);
+
+    std::vector<float> simplifiedPositions(positions, positions + verticesNumber * 3);
+    std::vector<std::vector<uint32_t>> partitionIndices(partitions.size());
+
+    double ratio = (double)targetTrianglesNumber / std::max<size_t>(1, trianglesNumber);
+
+    ParallelFor(partitions.size(), 1, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        for (size_t part = begin; part < end; part++)
+        {
+            if (cancelled)
+                return;
+
+            size_t first = partitionFirst[partitions[part]];
+            size_t number = partitionFirst[partitions[part] + 1] - first;
+
+            PartitionSimplifier simplifier(positions, indices, partitionTriangles.data() + first, number, vertexPartitions.data());
+            simplifier.Simplify((size_t)std::llround(number * ratio));
+            simplifier.Write(simplifiedPositions.data(), partitionIndices[part]);
+        }
+    });
+
+    if (cancelled)
+        return Mesh();
+
+    // Keeps the vertices still used, numbered in the order the triangles use them
+    size_t indicesNumber{ 0 };
+    for (const std::vector<uint32_t>& part : partitionIndices)
+        indicesNumber += part.size();
+
+    std::vector<uint32_t> remap(verticesNumber, UINT32_MAX);
+    AlignedArray<uint32_t> simplifiedIndices(indicesNumber);
+    uint32_t usedNumber{ 0 };
+    size_t index{ 0 };
+
+    for (const std::vector<uint32_t>& part : partitionIndices)
+    {
+        for (uint32_t vertex : part)
+        {
+            if (remap[vertex] == UINT32_MAX)
+                remap[vertex] = usedNumber++;
+            simplifiedIndices[index++] = remap[vertex];
+        }
+    }
+
+    Mesh simplified(usedNumber);
+    float* simplifiedVertices = simplified.Positions();
+
+    for (size_t vertex = 0; vertex < verticesNumber; vertex++)
+        if (remap[vertex] != UINT32_MAX)
+            for (int axis = 0; axis < 3; axis++)
+                simplifiedVertices[(size_t)remap[vertex] * 3 + axis] = simplifiedPositions[vertex * 3 + axis];
+
+    simplified.SetIndices(std::move(simplifiedIndices));
+    return simplified;
+}
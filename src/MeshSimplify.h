@@ -0,0 +1,14 @@
+#pragma once
+
+#include "Mesh.h"
+
+#include <atomic>
+#include <cstddef>
+
+// Simplifies an indexed mesh towards targetTrianglesNumber triangles by quadric-error edge collapses
+// (Garland and Heckbert 1997). The triangles are split into a grid of spatial partitions that are simplified
+// in parallel; vertices shared by partitions stay put, and every other pass shifts the grid by half a cell,
+// so a chain of simplifications moves those seams. Boundary edges are held in place by heavily weighted planes
+// through them, the vertices of non-manifold edges are not moved, and no collapse may flip a triangle.
+// Returns a new mesh with only the vertices it uses, in the order of their first use; empty once cancelled is set.
+Mesh SimplifyMesh(const Mesh& mesh, size_t targetTrianglesNumber, unsigned int pass, const std::atomic<bool>& cancelled);
@@ -0,0 +1,158 @@
+#include "MeshWeld.h"
+
+#include "Parallel.h"
+
+#include <cstring>
+
+const size_t MIN_VERTICES_PER_WORKER{ 1 << 16 };
+
+const uint32_t EMPTY_SLOT{ UINT32_MAX };
+
+// Vertices a worker scans between two cancellation checks
+const size_t VERTICES_PER_CANCEL_CHECK{ 1 << 16 };
+
+// Position bits with -0 turned into +0, so both weld together
+static void VertexKey(const float* position, uint32_t key[3])
+{
+    for (int i = 0; i < 3; i++)
+    {
+        float coordinate = position[i] + 0.0f;
+        std::memcpy(&key[i], &coordinate, sizeof(float));
+    }
+}
+
+static uint32_t HashKey(const uint32_t key[3])
+{
+    uint64_t hash = key[0] * 0x9E3779B97F4A7C15ull;
+    hash ^= key[1] * 0xC2B2AE3D27D4EB4Full;
+    hash ^= key[2] * 0x165667B19E3779F9ull;
+    hash ^= hash >> 29;
+
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+static size_t TableSize(size_t entries)
+{
+    size_t size{ 16 };
+    while (size <= entries)
+        size *= 2;
+    return size;
+}
+
+void BuildWeldMap(const float* positions, size_t verticesNumber, WeldMap& map, const std::atomic<bool>& cancelled)
+{
+    // Every worker owns the vertices whose hash falls into its partition, so the hash tables need no locking.
+    // indices first holds the soup index of each vertex's first occurrence, then the unique index
+    std::vector<uint32_t> hashes(verticesNumber);
+    map.indices = AlignedArray<uint32_t>(verticesNumber);
+
+    unsigned int partitions = WorkerCount(verticesNumber, MIN_VERTICES_PER_WORKER);
+    std::vector<size_t> partitionVertices(partitions, 0);
+
+    ParallelFor(verticesNumber, MIN_VERTICES_PER_WORKER, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        for (size_t vertex = begin; vertex < end; vertex++)
+        {
+            uint32_t key[3];
+            VertexKey(positions + vertex * 3, key);
+            hashes[vertex] = HashKey(key);
+        }
+    });
+
+    for (size_t vertex = 0; vertex < verticesNumber; vertex++)
+        partitionVertices[(uint64_t)hashes[vertex] * partitions >> 32]++;
+
+    ParallelFor(partitions, 1, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        for (size_t partition = begin; partition < end; partition++)
+        {
+            std::vector<uint32_t> table(TableSize(partitionVertices[partition]), EMPTY_SLOT);
+            size_t mask = table.size() - 1;
+
+            for (size_t vertex = 0; vertex < verticesNumber; vertex++)
+            {
+                if ((vertex % VERTICES_PER_CANCEL_CHECK == 0) && cancelled)
+                    return;
+
+                uint32_t hash = hashes[vertex];
+                if (((uint64_t)hash * partitions >> 32) != partition)
+                    continue;
+
+                uint32_t key[3];
+                VertexKey(positions + vertex * 3, key);
+
+                for (size_t slot = hash & mask; ; slot = (slot + 1) & mask)
+                {
+                    if (table[slot] == EMPTY_SLOT)
+                    {
+                        table[slot] = static_cast<uint32_t>(vertex);
+                        map.indices[vertex] = static_cast<uint32_t>(vertex);
+                        break;
+                    }
+
+                    uint32_t otherKey[3];
+                    VertexKey(positions + table[slot] * 3, otherKey);
+                    if (std::memcmp(key, otherKey, sizeof(key)) == 0)
+                    {
+                        map.indices[vertex] = table[slot];
+                        break;
+                    }
+                }
+            }
+        }
+    });
+
+    // Some vertices are not mapped yet
+    if (cancelled)
+        return;
+
+    // Number the first occurrences in soup order; hashes is reused for the numbers
+    std::vector<uint32_t>& uniqueIndices = hashes;
+    std::vector<size_t> workerUniques(WorkerCount(verticesNumber, MIN_VERTICES_PER_WORKER), 0);
+
+    ParallelFor(verticesNumber, MIN_VERTICES_PER_WORKER, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        for (size_t vertex = begin; vertex < end; vertex++)
+            if (map.indices[vertex] == vertex)
+                workerUniques[worker]++;
+    });
+
+    std::vector<size_t> workerFirstUnique(workerUniques.size(), 0);
+    size_t uniquesNumber{ 0 };
+    for (size_t worker = 0; worker < workerUniques.size(); worker++)
+    {
+        workerFirstUnique[worker] = uniquesNumber;
+        uniquesNumber += workerUniques[worker];
+    }
+
+    map.sources.resize(uniquesNumber);
+
+    ParallelFor(verticesNumber, MIN_VERTICES_PER_WORKER, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        size_t unique = workerFirstUnique[worker];
+        for (size_t vertex = begin; vertex < end; vertex++)
+        {
+            if (map.indices[vertex] == vertex)
+            {
+                uniqueIndices[vertex] = static_cast<uint32_t>(unique);
+                map.sources[unique++] = static_cast<uint32_t>(vertex);
+            }
+        }
+    });
+
+    // Every first occurrence is numbered by now, its copies take the same number
+    ParallelFor(verticesNumber, MIN_VERTICES_PER_WORKER, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        for (size_t vertex = begin; vertex < end; vertex++)
+            map.indices[vertex] = uniqueIndices[map.indices[vertex]];
+    });
+}
+
+void GatherWeldedVertices(const float* positions, const WeldMap& map, size_t firstVertex, size_t verticesNumber, float* vertices)
+{
+    ParallelFor(verticesNumber, MIN_VERTICES_PER_WORKER, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        for (size_t vertex = begin; vertex < end; vertex++)
+            std::memcpy(vertices + vertex * 3, positions + (size_t)map.sources[firstVertex + vertex] * 3, 3 * sizeof(float));
+    });
+}
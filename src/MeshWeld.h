@@ -0,0 +1,26 @@
+#pragma once
+
+#include "AlignedArray.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// How the vertices of a triangle soup (3 floats each, 3 per triangle) map onto unique positions.
+// Unique vertices keep the order of their first occurrence in the soup, so welding keeps its locality.
+struct WeldMap
+{
+    // Per soup vertex, the index of its unique vertex: the index buffer of the welded mesh
+    AlignedArray<uint32_t> indices;
+
+    // Per unique vertex, the soup vertex it is copied from
+    std::vector<uint32_t> sources;
+};
+
+// Welds positions that are bit-identical once -0 is taken for +0, in parallel; the soup must have
+// fewer than UINT32_MAX vertices. The map is incomplete once cancelled is set.
+void BuildWeldMap(const float* positions, size_t verticesNumber, WeldMap& map, const std::atomic<bool>& cancelled);
+
+// Copies unique vertices [firstVertex, firstVertex + verticesNumber) to vertices, in parallel
+void GatherWeldedVertices(const float* positions, const WeldMap& map, size_t firstVertex, size_t verticesNumber, float* vertices);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+inline unsigned int HardwareThreads()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+inline unsigned int& WorkerBudgetOfThread()
+{
+    thread_local unsigned int budget{ 0 };
+    return budget;
+}
+
+// Caps the workers ParallelFor uses when called from this thread, so jobs running side by side share the hardware
+// threads instead of each taking all of them; 0 lifts the cap
+inline void SetWorkerBudget(unsigned int workers)
+{
+    WorkerBudgetOfThread() = workers;
+}
+
+// Workers ParallelFor may use when called from this thread
+inline unsigned int WorkerBudget()
+{
+    unsigned int budget = WorkerBudgetOfThread();
+    return (budget > 0) ? std::min(budget, HardwareThreads()) : HardwareThreads();
+}
+
+// Number of workers ParallelFor uses for count items, giving each at least minRangeSize of them
+inline unsigned int WorkerCount(size_t count, size_t minRangeSize)
+{
+    size_t workers = std::min<size_t>(WorkerBudget(), std::max<size_t>(1, count / std::max<size_t>(1, minRangeSize)));
+
+    return static_cast<unsigned int>(workers);
+}
+
+// Splits [0, count) into contiguous ranges and calls func(begin, end, worker) for each range,
+// the first one on the calling thread and the rest on their own threads
+template <typename Func>
+void ParallelFor(size_t count, size_t minRangeSize, Func func)
+{
+    unsigned int workers = WorkerCount(count, minRangeSize);
+    size_t rangeSize = (count + workers - 1) / workers;
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+
+    for (unsigned int worker = 1; worker < workers; worker++)
+    {
+        size_t begin = std::min(count, worker * rangeSize);
+        size_t end = std::min(count, begin + rangeSize);
+        threads.emplace_back([=, &func] { func(begin, end, worker); });
+    }
+
+    func(0, std::min(count, rangeSize), 0u);
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
@@ -0,0 +1,531 @@
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// MSVC compiles AVX2 intrinsics in any function, GCC and Clang only in functions built for the instruction set
+#if defined(_MSC_VER)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+static void CpuId(int leaf, int registers[4])
+{
+#if defined(_MSC_VER)
+    __cpuidex(registers, leaf, 0);
+#else
+    unsigned int a, b, c, d;
+    __cpuid_count(leaf, 0, a, b, c, d);
+    registers[0] = (int)a;
+    registers[1] = (int)b;
+    registers[2] = (int)c;
+    registers[3] = (int)d;
+#endif
+}
+
+// Register state the OS saves on a context switch
+static uint64_t ReadXcr0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int low, high;
+    __asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+    return ((uint64_t)high << 32) | low;
+#endif
+}
+
+static SimdLevel DetectSimdLevel()
+{
+    int registers[4];
+
+    CpuId(0, registers);
+    int maxLeaf = registers[0];
+
+    CpuId(1, registers);
+    bool sse2 = (registers[3] & (1 << 26)) != 0;
+    bool osxsave = (registers[2] & (1 << 27)) != 0;
+    bool avx = (registers[2] & (1 << 28)) != 0;
+
+    // AVX2 also needs the OS to save the upper halves of the YMM registers
+    bool avx2{ false };
+    if ((maxLeaf >= 7) && osxsave && avx && ((ReadXcr0() & 6) == 6))
+    {
+        CpuId(7, registers);
+        avx2 = (registers[1] & (1 << 5)) != 0;
+    }
+
+    if (avx2)
+        return SimdLevel::AVX2;
+
+    return sse2 ? SimdLevel::SSE2 : SimdLevel::SCALAR;
+}
+
+SimdLevel SupportedSimdLevel()
+{
+    static const SimdLevel level = DetectSimdLevel();
+    return level;
+}
+
+const char* SimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::SSE2:
+        return "SSE2";
+    case SimdLevel::AVX2:
+        return "AVX2";
+    default:
+        return "scalar";
+    }
+}
+
+static void ResetBounds(float minimum[3], float maximum[3])
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        minimum[axis] = FLT_MAX;
+        maximum[axis] = -FLT_MAX;
+    }
+}
+
+// Registers stored one after the other hold the interleaved coordinates in order, so lane i holds axis i % 3
+static void MergeLanes(const float* minimumLanes, const float* maximumLanes, size_t lanesNumber, float minimum[3], float maximum[3])
+{
+    for (size_t lane = 0; lane < lanesNumber; lane++)
+    {
+        minimum[lane % 3] = std::min(minimum[lane % 3], minimumLanes[lane]);
+        maximum[lane % 3] = std::max(maximum[lane % 3], maximumLanes[lane]);
+    }
+}
+
+static void PointsBoundsScalar(const float* points, size_t pointsNumber, float minimum[3], float maximum[3])
+{
+    for (size_t point = 0; point < pointsNumber; point++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            minimum[axis] = std::min(minimum[axis], points[point * 3 + axis]);
+            maximum[axis] = std::max(maximum[axis], points[point * 3 + axis]);
+        }
+    }
+}
+
+static void TransformPointsScalar(const float matrix[16], const float* points, size_t pointsNumber, float* transformed)
+{
+    for (size_t point = 0; point < pointsNumber; point++)
+    {
+        const float* p = points + point * 3;
+        for (int axis = 0; axis < 3; axis++)
+            transformed[point * 3 + axis] = matrix[axis] * p[0] + matrix[4 + axis] * p[1] + matrix[8 + axis] * p[2] + matrix[12 + axis];
+    }
+}
+
+static void TransformedBoundsScalar(const float matrix[16], const float* points, size_t pointsNumber, float minimum[3], float maximum[3])
+{
+    for (size_t point = 0; point < pointsNumber; point++)
+    {
+        const float* p = points + point * 3;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float coordinate = matrix[axis] * p[0] + matrix[4 + axis] * p[1] + matrix[8 + axis] * p[2] + matrix[12 + axis];
+            minimum[axis] = std::min(minimum[axis], coordinate);
+            maximum[axis] = std::max(maximum[axis], coordinate);
+        }
+    }
+}
+
+static void TransformedComponentsBoundsScalar(const float matrix[16], const float* x, const float* y, const float* z, size_t pointsNumber,
+    float minimum[3], float maximum[3])
+{
+    for (size_t point = 0; point < pointsNumber; point++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float coordinate = matrix[axis] * x[point] + matrix[4 + axis] * y[point] + matrix[8 + axis] * z[point] + matrix[12 + axis];
+            minimum[axis] = std::min(minimum[axis], coordinate);
+            maximum[axis] = std::max(maximum[axis], coordinate);
+        }
+    }
+}
+
+// 4 points are 3 registers of interleaved coordinates, reduced lane by lane
+static void PointsBoundsSse2(const float* points, size_t pointsNumber, float minimum[3], float maximum[3])
+{
+    __m128 minimums[3], maximums[3];
+    for (int i = 0; i < 3; i++)
+    {
+        minimums[i] = _mm_set1_ps(FLT_MAX);
+        maximums[i] = _mm_set1_ps(-FLT_MAX);
+    }
+
+    size_t point{ 0 };
+    for (; point + 4 <= pointsNumber; point += 4)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            __m128 coordinates = _mm_loadu_ps(points + point * 3 + i * 4);
+            minimums[i] = _mm_min_ps(minimums[i], coordinates);
+            maximums[i] = _mm_max_ps(maximums[i], coordinates);
+        }
+    }
+
+    float minimumLanes[12], maximumLanes[12];
+    for (int i = 0; i < 3; i++)
+    {
+        _mm_storeu_ps(minimumLanes + i * 4, minimums[i]);
+        _mm_storeu_ps(maximumLanes + i * 4, maximums[i]);
+    }
+
+    MergeLanes(minimumLanes, maximumLanes, 12, minimum, maximum);
+    PointsBoundsScalar(points + point * 3, pointsNumber - point, minimum, maximum);
+}
+
+// One point per register: the matrix columns scaled by its coordinates, with the last lane unused
+static inline __m128 TransformPointSse2(const __m128 columns[4], const float* p)
+{
+    __m128 x = _mm_mul_ps(columns[0], _mm_set1_ps(p[0]));
+    __m128 y = _mm_mul_ps(columns[1], _mm_set1_ps(p[1]));
+    __m128 z = _mm_mul_ps(columns[2], _mm_set1_ps(p[2]));
+
+    return _mm_add_ps(_mm_add_ps(_mm_add_ps(x, y), z), columns[3]);
+}
+
+static void TransformPointsSse2(const float matrix[16], const float* points, size_t pointsNumber, float* transformed)
+{
+    __m128 columns[4]{ _mm_loadu_ps(matrix), _mm_loadu_ps(matrix + 4), _mm_loadu_ps(matrix + 8), _mm_loadu_ps(matrix + 12) };
+
+    if (pointsNumber == 0)
+        return;
+
+    // The fourth lane spills onto the next point, which overwrites it
+    for (size_t point = 0; point + 1 < pointsNumber; point++)
+        _mm_storeu_ps(transformed + point * 3, TransformPointSse2(columns, points + point * 3));
+
+    float last[4];
+    _mm_storeu_ps(last, TransformPointSse2(columns, points + (pointsNumber - 1) * 3));
+    std::memcpy(transformed + (pointsNumber - 1) * 3, last, 3 * sizeof(float));
+}
+
+static void TransformedBoundsSse2(const float matrix[16], const float* points, size_t pointsNumber, float minimum[3], float maximum[3])
+{
+    __m128 columns[4]{ _mm_loadu_ps(matrix), _mm_loadu_ps(matrix + 4), _mm_loadu_ps(matrix + 8), _mm_loadu_ps(matrix + 12) };
+
+    __m128 minimums = _mm_set1_ps(FLT_MAX);
+    __m128 maximums = _mm_set1_ps(-FLT_MAX);
+
+    for (size_t point = 0; point < pointsNumber; point++)
+    {
+        __m128 coordinates = TransformPointSse2(columns, points + point * 3);
+        minimums = _mm_min_ps(minimums, coordinates);
+        maximums = _mm_max_ps(maximums, coordinates);
+    }
+
+    float minimumLanes[4], maximumLanes[4];
+    _mm_storeu_ps(minimumLanes, minimums);
+    _mm_storeu_ps(maximumLanes, maximums);
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        minimum[axis] = std::min(minimum[axis], minimumLanes[axis]);
+        maximum[axis] = std::max(maximum[axis], maximumLanes[axis]);
+    }
+}
+
+// Row axis of the matrix applied to 4 points, in the order the scalar kernel adds the terms
+static inline __m128 TransformAxisSse2(const float matrix[16], int axis, __m128 x, __m128 y, __m128 z)
+{
+    __m128 sum = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(matrix[axis]), x), _mm_mul_ps(_mm_set1_ps(matrix[4 + axis]), y));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(matrix[8 + axis]), z));
+
+    return _mm_add_ps(sum, _mm_set1_ps(matrix[12 + axis]));
+}
+
+static void TransformedComponentsBoundsSse2(const float matrix[16], const float* x, const float* y, const float* z, size_t pointsNumber,
+    float minimum[3], float maximum[3])
+{
+    __m128 minimums[3], maximums[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        minimums[axis] = _mm_set1_ps(FLT_MAX);
+        maximums[axis] = _mm_set1_ps(-FLT_MAX);
+    }
+
+    size_t point{ 0 };
+    for (; point + 4 <= pointsNumber; point += 4)
+    {
+        __m128 xs = _mm_loadu_ps(x + point), ys = _mm_loadu_ps(y + point), zs = _mm_loadu_ps(z + point);
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            __m128 coordinates = TransformAxisSse2(matrix, axis, xs, ys, zs);
+            minimums[axis] = _mm_min_ps(minimums[axis], coordinates);
+            maximums[axis] = _mm_max_ps(maximums[axis], coordinates);
+        }
+    }
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float minimumLanes[4], maximumLanes[4];
+        _mm_storeu_ps(minimumLanes, minimums[axis]);
+        _mm_storeu_ps(maximumLanes, maximums[axis]);
+
+        for (int lane = 0; lane < 4; lane++)
+        {
+            minimum[axis] = std::min(minimum[axis], minimumLanes[lane]);
+            maximum[axis] = std::max(maximum[axis], maximumLanes[lane]);
+        }
+    }
+
+    TransformedComponentsBoundsScalar(matrix, x + point, y + point, z + point, pointsNumber - point, minimum, maximum);
+}
+
+TARGET_AVX2 static void PointsBoundsAvx2(const float* points, size_t pointsNumber, float minimum[3], float maximum[3])
+{
+    __m256 minimums[3], maximums[3];
+    for (int i = 0; i < 3; i++)
+    {
+        minimums[i] = _mm256_set1_ps(FLT_MAX);
+        maximums[i] = _mm256_set1_ps(-FLT_MAX);
+    }
+
+    size_t point{ 0 };
+    for (; point + 8 <= pointsNumber; point += 8)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            __m256 coordinates = _mm256_loadu_ps(points + point * 3 + i * 8);
+            minimums[i] = _mm256_min_ps(minimums[i], coordinates);
+            maximums[i] = _mm256_max_ps(maximums[i], coordinates);
+        }
+    }
+
+    float minimumLanes[24], maximumLanes[24];
+    for (int i = 0; i < 3; i++)
+    {
+        _mm256_storeu_ps(minimumLanes + i * 8, minimums[i]);
+        _mm256_storeu_ps(maximumLanes + i * 8, maximums[i]);
+    }
+
+    MergeLanes(minimumLanes, maximumLanes, 24, minimum, maximum);
+    PointsBoundsScalar(points + point * 3, pointsNumber - point, minimum, maximum);
+}
+
+// 8 interleaved points to one register per axis, with shuffles within 128-bit halves
+// (Intel, "3D Vector Normalization Using 256-Bit Intel AVX"); the lanes come out in an order of their own,
+// which InterleaveAvx2() reverses
+TARGET_AVX2 static inline void DeinterleaveAvx2(const float* p, __m256& x, __m256& y, __m256& z)
+{
+    __m256 m03 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)), _mm_loadu_ps(p + 12), 1);
+    __m256 m14 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 4)), _mm_loadu_ps(p + 16), 1);
+    __m256 m25 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 8)), _mm_loadu_ps(p + 20), 1);
+
+    __m256 xy = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+    __m256 yz = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+
+    x = _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+    y = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+    z = _mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+}
+
+TARGET_AVX2 static inline void InterleaveAvx2(__m256 x, __m256 y, __m256 z, float* p)
+{
+    __m256 xy = _mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));
+    __m256 yz = _mm256_shuffle_ps(y, z, _MM_SHUFFLE(3, 1, 3, 1));
+    __m256 zx = _mm256_shuffle_ps(z, x, _MM_SHUFFLE(3, 1, 2, 0));
+
+    __m256 m03 = _mm256_shuffle_ps(xy, zx, _MM_SHUFFLE(2, 0, 2, 0));
+    __m256 m14 = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+    __m256 m25 = _mm256_shuffle_ps(zx, yz, _MM_SHUFFLE(3, 1, 3, 1));
+
+    _mm_storeu_ps(p, _mm256_castps256_ps128(m03));
+    _mm_storeu_ps(p + 4, _mm256_castps256_ps128(m14));
+    _mm_storeu_ps(p + 8, _mm256_castps256_ps128(m25));
+    _mm_storeu_ps(p + 12, _mm256_extractf128_ps(m03, 1));
+    _mm_storeu_ps(p + 16, _mm256_extractf128_ps(m14, 1));
+    _mm_storeu_ps(p + 20, _mm256_extractf128_ps(m25, 1));
+}
+
+// Row axis of the matrix applied to 8 points, in the order the scalar kernel adds the terms
+TARGET_AVX2 static inline __m256 TransformAxisAvx2(const float matrix[16], int axis, __m256 x, __m256 y, __m256 z)
+{
+    __m256 sum = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(matrix[axis]), x), _mm256_mul_ps(_mm256_set1_ps(matrix[4 + axis]), y));
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(matrix[8 + axis]), z));
+
+    return _mm256_add_ps(sum, _mm256_set1_ps(matrix[12 + axis]));
+}
+
+TARGET_AVX2 static void TransformPointsAvx2(const float matrix[16], const float* points, size_t pointsNumber, float* transformed)
+{
+    size_t point{ 0 };
+    for (; point + 8 <= pointsNumber; point += 8)
+    {
+        __m256 x, y, z;
+        DeinterleaveAvx2(points + point * 3, x, y, z);
+
+        InterleaveAvx2(TransformAxisAvx2(matrix, 0, x, y, z), TransformAxisAvx2(matrix, 1, x, y, z), TransformAxisAvx2(matrix, 2, x, y, z),
+            transformed + point * 3);
+    }
+
+    TransformPointsSse2(matrix, points + point * 3, pointsNumber - point, transformed + point * 3);
+}
+
+TARGET_AVX2 static void TransformedBoundsAvx2(const float matrix[16], const float* points, size_t pointsNumber, float minimum[3], float maximum[3])
+{
+    __m256 minimums[3], maximums[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        minimums[axis] = _mm256_set1_ps(FLT_MAX);
+        maximums[axis] = _mm256_set1_ps(-FLT_MAX);
+    }
+
+    size_t point{ 0 };
+    for (; point + 8 <= pointsNumber; point += 8)
+    {
+        __m256 x, y, z;
+        DeinterleaveAvx2(points + point * 3, x, y, z);
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            __m256 coordinates = TransformAxisAvx2(matrix, axis, x, y, z);
+            minimums[axis] = _mm256_min_ps(minimums[axis], coordinates);
+            maximums[axis] = _mm256_max_ps(maximums[axis], coordinates);
+        }
+    }
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float minimumLanes[8], maximumLanes[8];
+        _mm256_storeu_ps(minimumLanes, minimums[axis]);
+        _mm256_storeu_ps(maximumLanes, maximums[axis]);
+
+        for (int lane = 0; lane < 8; lane++)
+        {
+            minimum[axis] = std::min(minimum[axis], minimumLanes[lane]);
+            maximum[axis] = std::max(maximum[axis], maximumLanes[lane]);
+        }
+    }
+
+    TransformedBoundsSse2(matrix, points + point * 3, pointsNumber - point, minimum, maximum);
+}
+
+TARGET_AVX2 static void TransformedComponentsBoundsAvx2(const float matrix[16], const float* x, const float* y, const float* z,
+    size_t pointsNumber, float minimum[3], float maximum[3])
+{
+    __m256 minimums[3], maximums[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        minimums[axis] = _mm256_set1_ps(FLT_MAX);
+        maximums[axis] = _mm256_set1_ps(-FLT_MAX);
+    }
+
+    size_t point{ 0 };
+    for (; point + 8 <= pointsNumber; point += 8)
+    {
+        __m256 xs = _mm256_loadu_ps(x + point), ys = _mm256_loadu_ps(y + point), zs = _mm256_loadu_ps(z + point);
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            __m256 coordinates = TransformAxisAvx2(matrix, axis, xs, ys, zs);
+            minimums[axis] = _mm256_min_ps(minimums[axis], coordinates);
+            maximums[axis] = _mm256_max_ps(maximums[axis], coordinates);
+        }
+    }
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float minimumLanes[8], maximumLanes[8];
+        _mm256_storeu_ps(minimumLanes, minimums[axis]);
+        _mm256_storeu_ps(maximumLanes, maximums[axis]);
+
+        for (int lane = 0; lane < 8; lane++)
+        {
+            minimum[axis] = std::min(minimum[axis], minimumLanes[lane]);
+            maximum[axis] = std::max(maximum[axis], maximumLanes[lane]);
+        }
+    }
+
+    TransformedComponentsBoundsSse2(matrix, x + point, y + point, z + point, pointsNumber - point, minimum, maximum);
+}
+
+void PointsBounds(const float* points, size_t pointsNumber, float minimum[3], float maximum[3], SimdLevel level)
+{
+    ResetBounds(minimum, maximum);
+
+    switch (std::min(level, SupportedSimdLevel()))
+    {
+    case SimdLevel::AVX2:
+        PointsBoundsAvx2(points, pointsNumber, minimum, maximum);
+        break;
+    case SimdLevel::SSE2:
+        PointsBoundsSse2(points, pointsNumber, minimum, maximum);
+        break;
+    default:
+        PointsBoundsScalar(points, pointsNumber, minimum, maximum);
+        break;
+    }
+}
+
+void TransformPoints(const float matrix[16], const float* points, size_t pointsNumber, float* transformed, SimdLevel level)
+{
+    switch (std::min(level, SupportedSimdLevel()))
+    {
+    case SimdLevel::AVX2:
+        TransformPointsAvx2(matrix, points, pointsNumber, transformed);
+        break;
+    case SimdLevel::SSE2:
+        TransformPointsSse2(matrix, points, pointsNumber, transformed);
+        break;
+    default:
+        TransformPointsScalar(matrix, points, pointsNumber, transformed);
+        break;
+    }
+}
+
+void TransformedBounds(const float matrix[16], const float* points, size_t pointsNumber, float minimum[3], float maximum[3], SimdLevel level)
+{
+    ResetBounds(minimum, maximum);
+
+    switch (std::min(level, SupportedSimdLevel()))
+    {
+    case SimdLevel::AVX2:
+        TransformedBoundsAvx2(matrix, points, pointsNumber, minimum, maximum);
+        break;
+    case SimdLevel::SSE2:
+        TransformedBoundsSse2(matrix, points, pointsNumber, minimum, maximum);
+        break;
+    default:
+        TransformedBoundsScalar(matrix, points, pointsNumber, minimum, maximum);
+        break;
+    }
+}
+
+void TransformedBounds(const float matrix[16], const float* x, const float* y, const float* z, size_t pointsNumber,
+    float minimum[3], float maximum[3], SimdLevel level)
+{
+    ResetBounds(minimum, maximum);
+
+    switch (std::min(level, SupportedSimdLevel()))
+    {
+    case SimdLevel::AVX2:
+        TransformedComponentsBoundsAvx2(matrix, x, y, z, pointsNumber, minimum, maximum);
+        break;
+    case SimdLevel::SSE2:
+        TransformedComponentsBoundsSse2(matrix, x, y, z, pointsNumber, minimum, maximum);
+        break;
+    default:
+        TransformedComponentsBoundsScalar(matrix, x, y, z, pointsNumber, minimum, maximum);
+        break;
+    }
+}
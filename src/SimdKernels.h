@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+// Instruction sets the kernels come in; the widest one the CPU and the OS support is picked at run time
+enum class SimdLevel
+{
+    SCALAR = 0, SSE2 = 1, AVX2 = 2
+};
+
+SimdLevel SupportedSimdLevel();
+const char* SimdLevelName(SimdLevel level);
+
+// Kernels over arrays of points stored as 3 interleaved floats. Matrices are 4x4 and column-major as in
+// OpenGL, the last row is taken to be (0, 0, 0, 1). A level above the supported one runs as the supported one.
+
+// Bounds of the points; FLT_MAX and -FLT_MAX without points, so results merge with std::min and std::max
+void PointsBounds(const float* points, size_t pointsNumber, float minimum[3], float maximum[3],
+    SimdLevel level = SupportedSimdLevel());
+
+void TransformPoints(const float matrix[16], const float* points, size_t pointsNumber, float* transformed,
+    SimdLevel level = SupportedSimdLevel());
+
+// Bounds of the transformed points, without storing them
+void TransformedBounds(const float matrix[16], const float* points, size_t pointsNumber, float minimum[3], float maximum[3],
+    SimdLevel level = SupportedSimdLevel());
+
+// Same over points stored as one array per coordinate, which needs no shuffles to fill a register per axis
+void TransformedBounds(const float matrix[16], const float* x, const float* y, const float* z, size_t pointsNumber,
+    float minimum[3], float maximum[3], SimdLevel level = SupportedSimdLevel());
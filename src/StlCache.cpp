@@ -0,0 +1,309 @@
+#include "StlCache.h"
+
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+const char STL_CACHE_MAGIC[8]{ 'S', 'T', 'L', 'C', 'A', 'C', 'H', 'E' };
+const uint32_t STL_CACHE_VERSION{ 6 };
+
+const size_t STL_CACHE_ALIGNMENT{ 64 };
+
+// The header is read and written as it is, so a change to its layout is a new version
+static_assert(sizeof(StlCacheHeader) == 160, "StlCacheHeader changed: bump STL_CACHE_VERSION and update this size");
+
+// Indices and clusters every worker checks at least when a cache is opened
+const size_t INDICES_PER_CHECK{ 1 << 20 };
+const size_t CLUSTERS_PER_CHECK{ 1 << 14 };
+
+// Bytes hashed at each end of the source; an edit that keeps both the size and the modification
+// time is very unlikely to leave them intact as well
+const size_t STAMP_HASHED_SIZE{ 1 << 16 };
+
+static size_t AlignedSize(size_t size)
+{
+    return (size + STL_CACHE_ALIGNMENT - 1) / STL_CACHE_ALIGNMENT * STL_CACHE_ALIGNMENT;
+}
+
+// 64-bit FNV-1a
+static uint64_t Hash(uint64_t hash, const unsigned char* data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string StlCachePath(const std::string& filepath)
+{
+    return filepath + ".stlcache";
+}
+
+bool ReadStlSourceStamp(const std::string& filepath, const unsigned char* data, size_t size, StlSourceStamp& stamp)
+{
+    std::error_code error;
+    std::filesystem::file_time_type modified = std::filesystem::last_write_time(std::filesystem::u8path(filepath), error);
+    if (error)
+        return false;
+
+    size_t headSize = std::min(size, STAMP_HASHED_SIZE);
+    size_t tailSize = std::min(size - headSize, STAMP_HASHED_SIZE);
+
+    stamp.size = size;
+    stamp.modified = (int64_t)modified.time_since_epoch().count();
+    stamp.hash = Hash(Hash(14695981039346656037ull, data, headSize), data + size - tailSize, tailSize);
+
+    return true;
+}
+
+bool StlCache::Open(const std::string& cachePath, const StlSourceStamp& source, IndexOrder indexOrder, VertexFormat vertexFormat,
+    float creaseAngle)
+{
+    if (!m_File.Open(cachePath) || (m_File.Size() < sizeof(StlCacheHeader)))
+        return false;
+
+    std::memcpy(&m_Header, m_File.Data(), sizeof(StlCacheHeader));
+
+    bool valid = (std::memcmp(m_Header.magic, STL_CACHE_MAGIC, sizeof(STL_CACHE_MAGIC)) == 0) &&
+        (m_Header.version == STL_CACHE_VERSION) && (m_Header.headerSize == sizeof(StlCacheHeader)) &&
+        (m_Header.source.size == source.size) && (m_Header.source.modified == source.modified) &&
+        (m_Header.source.hash == source.hash) && (m_Header.indexOrder == indexOrder) && (m_Header.vertexFormat == vertexFormat) &&
+        (m_Header.creaseAngle == creaseAngle) &&
+        (m_Header.indicesNumber == m_Header.trianglesNumber * 3) && (m_Header.verticesNumber <= m_Header.indicesNumber) &&
+        (m_Header.verticesOffset % STL_CACHE_ALIGNMENT == 0) && (m_Header.indicesOffset % STL_CACHE_ALIGNMENT == 0) &&
+        (m_Header.verticesOffset + m_Header.verticesNumber * VertexSize(vertexFormat) <= m_Header.indicesOffset) &&
+        (m_Header.clustersOffset % STL_CACHE_ALIGNMENT == 0) &&
+        (m_Header.indicesOffset + m_Header.indicesNumber * sizeof(uint32_t) <= m_Header.clustersOffset) &&
+        (m_Header.clustersNumber <= m_Header.trianglesNumber) && (m_Header.edgesOffset % STL_CACHE_ALIGNMENT == 0) &&
+        (m_Header.clustersOffset + m_Header.clustersNumber * sizeof(ClusterNode) <= m_Header.edgesOffset) &&
+        (m_Header.edgesIndicesNumber <= m_Header.indicesNumber * 2) && (m_Header.edgesOffset <= m_File.Size()) &&
+        ((m_File.Size() - m_Header.edgesOffset) / sizeof(uint32_t) >= m_Header.edgesIndicesNumber);
+
+    valid = valid && CheckPayload();
+
+    if (!valid)
+        m_File.Close();
+
+    return valid;
+}
+
+bool StlCache::CheckPayload() const
+{
+    // A damaged or foreign payload would have the GPU read past the vertex buffer, or the culling past the triangles
+    std::atomic<bool> valid{ true };
+
+    uint64_t verticesNumber = m_Header.verticesNumber;
+    auto checkIndices = [&](const uint32_t* indices, size_t indicesNumber)
+    {
+        ParallelFor(indicesNumber, INDICES_PER_CHECK, [&](size_t begin, size_t end, unsigned int)
+        {
+            uint32_t maxIndex{ 0 };
+            for (size_t i = begin; i < end; i++)
+                maxIndex = std::max(maxIndex, indices[i]);
+
+            if ((end > begin) && (maxIndex >= verticesNumber))
+                valid = false;
+        });
+    };
+
+    checkIndices(Indices(), (size_t)m_Header.indicesNumber);
+    checkIndices(EdgesIndices(), (size_t)m_Header.edgesIndicesNumber);
+
+    const ClusterNode* clusters = Clusters();
+    uint64_t clustersNumber = m_Header.clustersNumber;
+    uint64_t trianglesNumber = m_Header.trianglesNumber;
+    ParallelFor((size_t)clustersNumber, CLUSTERS_PER_CHECK, [&](size_t begin, size_t end, unsigned int)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            const ClusterNode& node = clusters[i];
+            if (((uint64_t)node.firstTriangle + node.trianglesNumber > trianglesNumber) || (node.skip <= i) || (node.skip > clustersNumber))
+            {
+                valid = false;
+                return;
+            }
+        }
+    });
+
+    return valid;
+}
+
+const unsigned char* StlCache::Vertices() const
+{
+    return m_File.Data() + m_Header.verticesOffset;
+}
+
+const uint32_t* StlCache::Indices() const
+{
+    return reinterpret_cast<const uint32_t*>(m_File.Data() + m_Header.indicesOffset);
+}
+
+const ClusterNode* StlCache::Clusters() const
+{
+    return reinterpret_cast<const ClusterNode*>(m_File.Data() + m_Header.clustersOffset);
+}
+
+const uint32_t* StlCache::EdgesIndices() const
+{
+    return reinterpret_cast<const uint32_t*>(m_File.Data() + m_Header.edgesOffset);
+}
+
+Mesh StlCache::DecodeMesh(bool withIndices) const
+{
+    Mesh mesh(VerticesNumber());
+    DecodePositions(Vertices(), VerticesNumber(), Bounds(), m_Header.vertexFormat, mesh.Positions());
+
+    if (withIndices)
+    {
+        AlignedArray<uint32_t> indices((size_t)m_Header.indicesNumber);
+        std::memcpy(indices.Data(), Indices(), indices.Size() * sizeof(uint32_t));
+        mesh.SetIndices(std::move(indices));
+    }
+
+    return mesh;
+}
+
+StlCacheWriter::~StlCacheWriter()
+{
+    Abandon();
+}
+
+bool StlCacheWriter::Begin(const std::string& cachePath, const StlSourceStamp& source, IndexOrder indexOrder, VertexFormat vertexFormat,
+    float creaseAngle, size_t trianglesNumber, size_t verticesNumber, size_t clustersNumber, size_t edgesIndicesNumber,
+    size_t meshEdgesNumber)
+{
+    Abandon();
+
+    m_CachePath = cachePath;
+    m_TemporaryPath = cachePath + ".tmp";
+
+    m_Stream.open(std::filesystem::u8path(m_TemporaryPath), std::ios::binary | std::ios::trunc);
+    if (!m_Stream)
+        return false;
+
+    std::memcpy(m_Header.magic, STL_CACHE_MAGIC, sizeof(STL_CACHE_MAGIC));
+    m_Header.version = STL_CACHE_VERSION;
+    m_Header.headerSize = sizeof(StlCacheHeader);
+    m_Header.source = source;
+    m_Header.indexOrder = indexOrder;
+    m_Header.vertexFormat = vertexFormat;
+    m_Header.trianglesNumber = trianglesNumber;
+    m_Header.verticesNumber = verticesNumber;
+    m_Header.indicesNumber = trianglesNumber * 3;
+    m_Header.verticesOffset = AlignedSize(sizeof(StlCacheHeader));
+    m_Header.indicesOffset = AlignedSize(m_Header.verticesOffset + m_Header.verticesNumber * VertexSize(vertexFormat));
+    m_Header.clustersNumber = clustersNumber;
+    m_Header.clustersOffset = AlignedSize(m_Header.indicesOffset + m_Header.indicesNumber * sizeof(uint32_t));
+    m_Header.edgesIndicesNumber = edgesIndicesNumber;
+    m_Header.edgesOffset = AlignedSize(m_Header.clustersOffset + m_Header.clustersNumber * sizeof(ClusterNode));
+    m_Header.meshEdgesNumber = meshEdgesNumber;
+    m_Header.creaseAngle = creaseAngle;
+
+    // The header is written last, so a cache cut short is never taken for a complete one
+    m_Written = 0;
+    PadTo(m_Header.verticesOffset);
+
+    return (bool)m_Stream;
+}
+
+void StlCacheWriter::AppendVertices(const void* vertices, size_t verticesNumber)
+{
+    if (!m_Stream.is_open())
+        return;
+
+    size_t size = verticesNumber * VertexSize(m_Header.vertexFormat);
+    m_Stream.write(static_cast<const char*>(vertices), size);
+    m_Written += size;
+}
+
+void StlCacheWriter::AppendIndices(const uint32_t* indices, size_t indicesNumber)
+{
+    if (!m_Stream.is_open())
+        return;
+
+    PadTo(m_Header.indicesOffset);
+    m_Stream.write(reinterpret_cast<const char*>(indices), indicesNumber * sizeof(uint32_t));
+    m_Written += indicesNumber * sizeof(uint32_t);
+}
+
+void StlCacheWriter::AppendClusters(const ClusterNode* clusters, size_t clustersNumber)
+{
+    if (!m_Stream.is_open())
+        return;
+
+    PadTo(m_Header.clustersOffset);
+    m_Stream.write(reinterpret_cast<const char*>(clusters), clustersNumber * sizeof(ClusterNode));
+    m_Written += clustersNumber * sizeof(ClusterNode);
+}
+
+void StlCacheWriter::AppendEdges(const uint32_t* edgesIndices, size_t edgesIndicesNumber)
+{
+    if (!m_Stream.is_open())
+        return;
+
+    PadTo(m_Header.edgesOffset);
+    m_Stream.write(reinterpret_cast<const char*>(edgesIndices), edgesIndicesNumber * sizeof(uint32_t));
+    m_Written += edgesIndicesNumber * sizeof(uint32_t);
+}
+
+bool StlCacheWriter::Finish(const StlBounds& bounds)
+{
+    if (!m_Stream.is_open())
+        return false;
+
+    // The file reaches the end of the last section even if it is empty
+    PadTo(m_Header.edgesOffset + m_Header.edgesIndicesNumber * sizeof(uint32_t));
+
+    m_Header.bounds = bounds;
+
+    m_Stream.seekp(0);
+    m_Stream.write(reinterpret_cast<const char*>(&m_Header), sizeof(StlCacheHeader));
+    m_Stream.close();
+
+    if (m_Stream.fail())
+    {
+        Abandon();
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(std::filesystem::u8path(m_TemporaryPath), std::filesystem::u8path(m_CachePath), error);
+    if (error)
+    {
+        Abandon();
+        return false;
+    }
+
+    m_TemporaryPath.clear();
+    return true;
+}
+
+void StlCacheWriter::PadTo(uint64_t offset)
+{
+    char padding[STL_CACHE_ALIGNMENT]{};
+    while (m_Written < offset)
+    {
+        size_t size = (size_t)std::min<uint64_t>(sizeof(padding), offset - m_Written);
+        m_Stream.write(padding, size);
+        m_Written += size;
+    }
+}
+
+void StlCacheWriter::Abandon()
+{
+    if (m_Stream.is_open())
+        m_Stream.close();
+
+    if (!m_TemporaryPath.empty())
+    {
+        std::error_code error;
+        std::filesystem::remove(std::filesystem::u8path(m_TemporaryPath), error);
+        m_TemporaryPath.clear();
+    }
+}
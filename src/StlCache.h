@@ -0,0 +1,130 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "MeshClusters.h"
+#include "StlLoader.h"
+#include "VertexCache.h"
+#include "VertexFormat.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Identifies the STL file a cache was written for: a cache is valid while the size, the modification
+// time and a hash of the first and last 64 KB of the source are unchanged
+struct StlSourceStamp
+{
+    uint64_t size;
+    int64_t modified;
+    uint64_t hash;
+};
+
+// Sidecar cache layout, all little-endian: this header, then the welded vertex buffer (in vertexFormat)
+// at verticesOffset, the 32-bit index buffer (3 per triangle) at indicesOffset, the cluster hierarchy over it
+// at clustersOffset and the feature edge lines over creaseAngle at edgesOffset, all 64-byte aligned so the mapped
+// file can be handed to glBufferData as it is
+struct StlCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+
+    StlSourceStamp source;
+
+    IndexOrder indexOrder;
+    VertexFormat vertexFormat;
+
+    uint64_t trianglesNumber;
+    uint64_t verticesNumber;
+    uint64_t indicesNumber;
+    uint64_t verticesOffset;
+    uint64_t indicesOffset;
+    uint64_t clustersNumber;
+    uint64_t clustersOffset;
+    uint64_t edgesIndicesNumber;
+    uint64_t edgesOffset;
+    uint64_t meshEdgesNumber;
+    float creaseAngle;
+
+    StlBounds bounds;
+};
+
+// "housing.stl" is cached in "housing.stl.stlcache"
+std::string StlCachePath(const std::string& filepath);
+
+// data and size are the mapped source file
+bool ReadStlSourceStamp(const std::string& filepath, const unsigned char* data, size_t size, StlSourceStamp& stamp);
+
+// A cache file mapped for reading
+class StlCache
+{
+public:
+    // Returns false if there is no cache, it was not written for the given source, index order, vertex format
+    // and crease angle, or its indices or clusters are out of range
+    bool Open(const std::string& cachePath, const StlSourceStamp& source, IndexOrder indexOrder, VertexFormat vertexFormat,
+        float creaseAngle);
+
+    size_t TrianglesNumber() const { return (size_t)m_Header.trianglesNumber; }
+    const StlBounds& Bounds() const { return m_Header.bounds; }
+
+    const unsigned char* Vertices() const;
+    size_t VerticesNumber() const { return (size_t)m_Header.verticesNumber; }
+
+    const uint32_t* Indices() const;
+
+    const ClusterNode* Clusters() const;
+    size_t ClustersNumber() const { return (size_t)m_Header.clustersNumber; }
+
+    // The FeatureEdges lines and mesh edge count
+    const uint32_t* EdgesIndices() const;
+    size_t EdgesIndicesNumber() const { return (size_t)m_Header.edgesIndicesNumber; }
+    size_t MeshEdgesNumber() const { return (size_t)m_Header.meshEdgesNumber; }
+
+    // The welded mesh with float positions, and with its indices if asked; this reads the whole payload,
+    // so it is meant for the jobs that work on a cached model in the background
+    Mesh DecodeMesh(bool withIndices) const;
+
+private:
+    // Whether every index and edge index refers to a vertex and every cluster node to triangles and nodes inside the file
+    bool CheckPayload() const;
+
+    MappedFile m_File;
+    StlCacheHeader m_Header{};
+};
+
+// Writes a cache while the model is parsed, into a temporary file that replaces the cache
+// once Finish() succeeds; an unfinished one is deleted
+class StlCacheWriter
+{
+public:
+    StlCacheWriter() = default;
+    ~StlCacheWriter();
+
+    StlCacheWriter(const StlCacheWriter&) = delete;
+    StlCacheWriter& operator=(const StlCacheWriter&) = delete;
+
+    bool Begin(const std::string& cachePath, const StlSourceStamp& source, IndexOrder indexOrder, VertexFormat vertexFormat,
+        float creaseAngle, size_t trianglesNumber, size_t verticesNumber, size_t clustersNumber, size_t edgesIndicesNumber,
+        size_t meshEdgesNumber);
+
+    // All vertices are appended first, then all indices, then all clusters, then all edge indices, each in order
+    void AppendVertices(const void* vertices, size_t verticesNumber);
+    void AppendIndices(const uint32_t* indices, size_t indicesNumber);
+    void AppendClusters(const ClusterNode* clusters, size_t clustersNumber);
+    void AppendEdges(const uint32_t* edgesIndices, size_t edgesIndicesNumber);
+
+    bool Finish(const StlBounds& bounds);
+
+private:
+    // Pads the file up to offset, where the next section starts
+    void PadTo(uint64_t offset);
+
+    void Abandon();
+
+    std::string m_CachePath;
+    std::string m_TemporaryPath;
+    std::ofstream m_Stream;
+    uint64_t m_Written{ 0 };
+    StlCacheHeader m_Header{};
+};
@@ -0,0 +1,324 @@
+#include "StlChunks.h"
+
+#include "Parallel.h"
+
+#include <float.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <vector>
+
+const char STL_CHUNKS_MAGIC[8]{ 'S', 'T', 'L', 'C', 'H', 'U', 'N', 'K' };
+const uint32_t STL_CHUNKS_VERSION{ 2 };
+
+const size_t STL_CHUNKS_ALIGNMENT{ 64 };
+
+// The chunks are made of the cells of a grid with 2^GRID_LEVELS cells per axis, numbered in Morton order
+// so every octree node covers a contiguous range of them
+const unsigned int GRID_LEVELS{ 6 };
+const uint32_t GRID_SIZE{ 1u << GRID_LEVELS };
+const uint32_t GRID_CELLS{ GRID_SIZE * GRID_SIZE * GRID_SIZE };
+
+// Triangles read from the source at once, between two progress updates and cancellation checks
+const size_t TRIANGLES_PER_BATCH{ 1 << 20 };
+const size_t MIN_TRIANGLES_PER_WORKER{ 1 << 16 };
+
+const size_t TRIANGLE_SIZE{ 9 * sizeof(float) };
+
+static size_t AlignedSize(size_t size)
+{
+    return (size + STL_CHUNKS_ALIGNMENT - 1) / STL_CHUNKS_ALIGNMENT * STL_CHUNKS_ALIGNMENT;
+}
+
+std::string StlChunksPath(const std::string& filepath)
+{
+    return filepath + ".stlchunks";
+}
+
+static uint32_t MortonCell(uint32_t x, uint32_t y, uint32_t z)
+{
+    uint32_t cell = 0;
+    for (unsigned int bit = 0; bit < GRID_LEVELS; bit++)
+        cell |= (((x >> bit) & 1u) << (3 * bit)) | (((y >> bit) & 1u) << (3 * bit + 1)) | (((z >> bit) & 1u) << (3 * bit + 2));
+
+    return cell;
+}
+
+// Maps the centroid of triangles to grid cells over bounds
+class GridMapping
+{
+public:
+    explicit GridMapping(const StlBounds& bounds)
+    {
+        float min[3]{ bounds.minX, bounds.minY, bounds.minZ };
+        float max[3]{ bounds.maxX, bounds.maxY, bounds.maxZ };
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            m_Min[axis] = min[axis];
+            m_Scale[axis] = (max[axis] > min[axis]) ? GRID_SIZE / (max[axis] - min[axis]) : 0.0f;
+        }
+    }
+
+    uint32_t Cell(const float* triangle) const
+    {
+        uint32_t coordinates[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float centroid = (triangle[axis] + triangle[3 + axis] + triangle[6 + axis]) / 3.0f;
+            float cell = (centroid - m_Min[axis]) * m_Scale[axis];
+            coordinates[axis] = (uint32_t)std::min(std::max(cell, 0.0f), (float)(GRID_SIZE - 1));
+        }
+
+        return MortonCell(coordinates[0], coordinates[1], coordinates[2]);
+    }
+
+private:
+    float m_Min[3];
+    float m_Scale[3];
+};
+
+// Parses a batch of triangles and finds their cells
+static StlBounds ParseBatch(const unsigned char* data, size_t firstTriangle, size_t trianglesNumber, const GridMapping* grid,
+    float* positions, uint32_t* cells)
+{
+    StlBounds bounds = ParseBinaryStl(data, firstTriangle, trianglesNumber, positions);
+
+    if (grid != nullptr)
+    {
+        ParallelFor(trianglesNumber, MIN_TRIANGLES_PER_WORKER, [&](size_t begin, size_t end, unsigned int worker)
+        {
+            for (size_t triangle = begin; triangle < end; triangle++)
+                cells[triangle] = grid->Cell(positions + triangle * 9);
+        });
+    }
+
+    return bounds;
+}
+
+// Makes a chunk of the octree node over cells [firstCell, firstCell + cellsNumber), or splits it in 8 while it
+// holds more than CHUNK_TRIANGLES; a single cell holding more makes consecutive chunks of CHUNK_TRIANGLES of its
+// triangles in file order. trianglesBefore[cell] counts the triangles in the cells before, cellChunks[cell] is set
+// to the cell's first chunk.
+static void SplitCells(const std::vector<uint64_t>& trianglesBefore, uint32_t firstCell, uint32_t cellsNumber,
+    std::vector<StlChunk>& chunks, std::vector<uint32_t>& cellChunks)
+{
+    uint64_t trianglesNumber = trianglesBefore[firstCell + cellsNumber] - trianglesBefore[firstCell];
+    if (trianglesNumber == 0)
+        return;
+
+    if ((trianglesNumber > CHUNK_TRIANGLES) && (cellsNumber > 1))
+    {
+        uint32_t childCells = cellsNumber / 8;
+        for (uint32_t child = 0; child < 8; child++)
+            SplitCells(trianglesBefore, firstCell + child * childCells, childCells, chunks, cellChunks);
+        return;
+    }
+
+    std::fill(cellChunks.begin() + firstCell, cellChunks.begin() + firstCell + cellsNumber, (uint32_t)chunks.size());
+
+    for (uint64_t first = 0; first < trianglesNumber; first += CHUNK_TRIANGLES)
+    {
+        StlChunk chunk{ { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX }, trianglesBefore[firstCell] + first,
+            std::min<uint64_t>(CHUNK_TRIANGLES, trianglesNumber - first) };
+        chunks.push_back(chunk);
+    }
+}
+
+bool BuildStlChunks(const std::string& chunksPath, const StlSourceStamp& source, const unsigned char* data, size_t trianglesNumber,
+    const std::atomic<bool>& cancelled, std::atomic<float>& progress, float progressBegin, float progressEnd)
+{
+    std::vector<float> positions(std::min(trianglesNumber, TRIANGLES_PER_BATCH) * 9);
+    std::vector<uint32_t> cells(std::min(trianglesNumber, TRIANGLES_PER_BATCH));
+
+    // Weights of the three passes in the progress, the last one writes
+    const float passBegin[3]{ 0.0f, 0.25f, 0.5f };
+    const float passEnd[3]{ 0.25f, 0.5f, 1.0f };
+
+    auto reportProgress = [&](int pass, size_t trianglesDone)
+    {
+        float passProgress = passBegin[pass] + (passEnd[pass] - passBegin[pass]) * trianglesDone / trianglesNumber;
+        progress = progressBegin + (progressEnd - progressBegin) * passProgress;
+    };
+
+    // Pass 1: the bounds the grid spans
+    StlBounds bounds = EmptyBounds();
+    for (size_t triangle = 0; triangle < trianglesNumber; triangle += TRIANGLES_PER_BATCH)
+    {
+        if (cancelled)
+            return false;
+
+        size_t batchSize = std::min(TRIANGLES_PER_BATCH, trianglesNumber - triangle);
+        MergeBounds(bounds, ParseBatch(data, triangle, batchSize, nullptr, positions.data(), nullptr));
+        reportProgress(0, triangle + batchSize);
+    }
+
+    // Pass 2: triangles per cell, which place the chunks
+    GridMapping grid(bounds);
+    std::vector<uint64_t> trianglesBefore(GRID_CELLS + 1, 0);
+
+    for (size_t triangle = 0; triangle < trianglesNumber; triangle += TRIANGLES_PER_BATCH)
+    {
+        if (cancelled)
+            return false;
+
+        size_t batchSize = std::min(TRIANGLES_PER_BATCH, trianglesNumber - triangle);
+        ParseBatch(data, triangle, batchSize, &grid, positions.data(), cells.data());
+
+        for (size_t i = 0; i < batchSize; i++)
+            trianglesBefore[cells[i] + 1]++;
+
+        reportProgress(1, triangle + batchSize);
+    }
+
+    for (uint32_t cell = 0; cell < GRID_CELLS; cell++)
+        trianglesBefore[cell + 1] += trianglesBefore[cell];
+
+    std::vector<StlChunk> chunks;
+    std::vector<uint32_t> cellChunks(GRID_CELLS, 0);
+    SplitCells(trianglesBefore, 0, GRID_CELLS, chunks, cellChunks);
+
+    StlChunksHeader header{};
+    std::memcpy(header.magic, STL_CHUNKS_MAGIC, sizeof(STL_CHUNKS_MAGIC));
+    header.version = STL_CHUNKS_VERSION;
+    header.headerSize = sizeof(StlChunksHeader);
+    header.source = source;
+    header.trianglesNumber = trianglesNumber;
+    header.chunksNumber = chunks.size();
+    header.chunksOffset = AlignedSize(sizeof(StlChunksHeader));
+    header.positionsOffset = AlignedSize(header.chunksOffset + chunks.size() * sizeof(StlChunk));
+    header.bounds = bounds;
+
+    std::string temporaryPath = chunksPath + ".tmp";
+    std::ofstream stream(std::filesystem::u8path(temporaryPath), std::ios::binary | std::ios::trunc);
+
+    auto abandon = [&]()
+    {
+        stream.close();
+        std::error_code error;
+        std::filesystem::remove(std::filesystem::u8path(temporaryPath), error);
+        return false;
+    };
+
+    if (!stream)
+        return abandon();
+
+    // Pass 3: every batch is sorted by chunk and each chunk's run appended where the chunk's triangles so far end
+    std::vector<float> sortedPositions(positions.size());
+    std::vector<size_t> batchChunkBegin(chunks.size() + 1);
+    std::vector<size_t> batchChunkEnd(chunks.size());
+    std::vector<uint64_t> chunkWritten(chunks.size(), 0);
+
+    // Triangles of every cell bucketed so far; the k-th one of a cell goes to chunk k / CHUNK_TRIANGLES of it,
+    // always its only one unless the cell alone was split into ranges
+    std::vector<uint64_t> cellTriangles(GRID_CELLS, 0);
+
+    for (size_t triangle = 0; triangle < trianglesNumber; triangle += TRIANGLES_PER_BATCH)
+    {
+        if (cancelled)
+            return abandon();
+
+        size_t batchSize = std::min(TRIANGLES_PER_BATCH, trianglesNumber - triangle);
+        ParseBatch(data, triangle, batchSize, &grid, positions.data(), cells.data());
+
+        std::fill(batchChunkBegin.begin(), batchChunkBegin.end(), 0);
+        for (size_t i = 0; i < batchSize; i++)
+        {
+            uint32_t cell = cells[i];
+            cells[i] = cellChunks[cell] + (uint32_t)(cellTriangles[cell]++ / CHUNK_TRIANGLES);
+            batchChunkBegin[cells[i] + 1]++;
+        }
+        for (size_t chunk = 0; chunk < chunks.size(); chunk++)
+            batchChunkBegin[chunk + 1] += batchChunkBegin[chunk];
+
+        std::copy(batchChunkBegin.begin(), batchChunkBegin.end() - 1, batchChunkEnd.begin());
+        for (size_t i = 0; i < batchSize; i++)
+        {
+            StlChunk& chunk = chunks[cells[i]];
+            const float* trianglePositions = positions.data() + i * 9;
+
+            for (int vertex = 0; vertex < 3; vertex++)
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    chunk.min[axis] = std::min(chunk.min[axis], trianglePositions[vertex * 3 + axis]);
+                    chunk.max[axis] = std::max(chunk.max[axis], trianglePositions[vertex * 3 + axis]);
+                }
+
+            std::memcpy(sortedPositions.data() + batchChunkEnd[cells[i]]++ * 9, trianglePositions, TRIANGLE_SIZE);
+        }
+
+        for (size_t chunk = 0; chunk < chunks.size(); chunk++)
+        {
+            size_t runSize = batchChunkBegin[chunk + 1] - batchChunkBegin[chunk];
+            if (runSize == 0)
+                continue;
+
+            stream.seekp(header.positionsOffset + (chunks[chunk].firstTriangle + chunkWritten[chunk]) * TRIANGLE_SIZE);
+            stream.write(reinterpret_cast<const char*>(sortedPositions.data() + batchChunkBegin[chunk] * 9), runSize * TRIANGLE_SIZE);
+            chunkWritten[chunk] += runSize;
+        }
+
+        if (!stream)
+            return abandon();
+
+        reportProgress(2, triangle + batchSize);
+    }
+
+    // The header is written last, so a file cut short is never taken for a complete one
+    stream.seekp(header.chunksOffset);
+    stream.write(reinterpret_cast<const char*>(chunks.data()), chunks.size() * sizeof(StlChunk));
+    stream.seekp(0);
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(StlChunksHeader));
+    stream.close();
+
+    if (stream.fail())
+        return abandon();
+
+    std::error_code error;
+    std::filesystem::rename(std::filesystem::u8path(temporaryPath), std::filesystem::u8path(chunksPath), error);
+    if (error)
+        return abandon();
+
+    return true;
+}
+
+bool StlChunks::Open(const std::string& chunksPath, const StlSourceStamp& source)
+{
+    if (!m_File.Open(chunksPath) || (m_File.Size() < sizeof(StlChunksHeader)))
+        return false;
+
+    std::memcpy(&m_Header, m_File.Data(), sizeof(StlChunksHeader));
+
+    bool valid = (std::memcmp(m_Header.magic, STL_CHUNKS_MAGIC, sizeof(STL_CHUNKS_MAGIC)) == 0) &&
+        (m_Header.version == STL_CHUNKS_VERSION) && (m_Header.headerSize == sizeof(StlChunksHeader)) &&
+        (m_Header.source.size == source.size) && (m_Header.source.modified == source.modified) &&
+        (m_Header.source.hash == source.hash) && (m_Header.chunksOffset % STL_CHUNKS_ALIGNMENT == 0) &&
+        (m_Header.positionsOffset % STL_CHUNKS_ALIGNMENT == 0) && (m_Header.chunksNumber <= m_Header.trianglesNumber) &&
+        (m_Header.chunksOffset + m_Header.chunksNumber * sizeof(StlChunk) <= m_Header.positionsOffset) &&
+        (m_Header.positionsOffset <= m_File.Size()) &&
+        ((m_File.Size() - m_Header.positionsOffset) / TRIANGLE_SIZE >= m_Header.trianglesNumber);
+
+    for (size_t chunk = 0; valid && (chunk < ChunksNumber()); chunk++)
+    {
+        const StlChunk& stored = Chunks()[chunk];
+        valid = (stored.firstTriangle <= m_Header.trianglesNumber) && (stored.trianglesNumber <= m_Header.trianglesNumber - stored.firstTriangle);
+    }
+
+    if (!valid)
+        m_File.Close();
+
+    return valid;
+}
+
+const StlChunk* StlChunks::Chunks() const
+{
+    return reinterpret_cast<const StlChunk*>(m_File.Data() + m_Header.chunksOffset);
+}
+
+const float* StlChunks::Positions(const StlChunk& chunk) const
+{
+    return reinterpret_cast<const float*>(m_File.Data() + m_Header.positionsOffset + chunk.firstTriangle * TRIANGLE_SIZE);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "StlCache.h"
+#include "StlLoader.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Binary STL files with more triangles than this are too large to load whole; they are drawn out of core,
+// a budget of their chunks at a time
+const size_t OUT_OF_CORE_MIN_TRIANGLES{ 100000000 };
+
+// Triangles per chunk at most
+const size_t CHUNK_TRIANGLES{ 1 << 18 };
+
+// A spatially coherent part of an out-of-core model: triangles [firstTriangle, firstTriangle + trianglesNumber)
+// of the chunk file and their bounds
+struct StlChunk
+{
+    float min[3];
+    float max[3];
+    uint64_t firstTriangle;
+    uint64_t trianglesNumber;
+};
+
+// Sidecar chunk file layout, all little-endian: this header, then the chunks at chunksOffset and the triangle soup
+// (9 floats per triangle) at positionsOffset, sorted chunk by chunk, both 64-byte aligned
+struct StlChunksHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+
+    StlSourceStamp source;
+
+    uint64_t trianglesNumber;
+    uint64_t chunksNumber;
+    uint64_t chunksOffset;
+    uint64_t positionsOffset;
+
+    StlBounds bounds;
+};
+
+// "scan.stl" is split into "scan.stl.stlchunks"
+std::string StlChunksPath(const std::string& filepath);
+
+// Splits the binary STL mapped at data into chunks, the leaves of an octree over a grid of the triangle centroids
+// whose nodes are split while they hold more than CHUNK_TRIANGLES, and writes the chunk file. A single grid cell
+// holding more is cut into ranges of its triangles. Streams through the
+// source three times: for the bounds, for the triangles per grid cell and for bucketing them into their chunks.
+// progress goes from progressBegin to progressEnd; returns false if cancelled or the file cannot be written.
+bool BuildStlChunks(const std::string& chunksPath, const StlSourceStamp& source, const unsigned char* data, size_t trianglesNumber,
+    const std::atomic<bool>& cancelled, std::atomic<float>& progress, float progressBegin, float progressEnd);
+
+// A chunk file mapped for reading
+class StlChunks
+{
+public:
+    // Returns false if there is no chunk file or it was not written for the given source
+    bool Open(const std::string& chunksPath, const StlSourceStamp& source);
+
+    size_t TrianglesNumber() const { return (size_t)m_Header.trianglesNumber; }
+    const StlBounds& Bounds() const { return m_Header.bounds; }
+
+    const StlChunk* Chunks() const;
+    size_t ChunksNumber() const { return (size_t)m_Header.chunksNumber; }
+
+    // The triangle soup of a chunk, 9 floats per triangle
+    const float* Positions(const StlChunk& chunk) const;
+
+private:
+    MappedFile m_File;
+    StlChunksHeader m_Header{};
+};
@@ -0,0 +1,295 @@
+#include "StlLoader.h"
+
+#include "Parallel.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Triangles per worker below which spawning another thread costs more than it saves
+const size_t MIN_TRIANGLES_PER_WORKER{ 1 << 16 };
+
+// Vertices are parsed into a local block of this many before they are copied out, so the bounds
+// kernel reads them from L1
+const size_t VERTICES_PER_BLOCK{ 768 };
+
+StlBounds EmptyBounds()
+{
+    return { FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX };
+}
+
+void MergeBounds(StlBounds& bounds, const StlBounds& other)
+{
+    bounds.minX = std::min(bounds.minX, other.minX);
+    bounds.maxX = std::max(bounds.maxX, other.maxX);
+    bounds.minY = std::min(bounds.minY, other.minY);
+    bounds.maxY = std::max(bounds.maxY, other.maxY);
+    bounds.minZ = std::min(bounds.minZ, other.minZ);
+    bounds.maxZ = std::max(bounds.maxZ, other.maxZ);
+}
+
+static void MergeBlockBounds(StlBounds& bounds, const float* block, size_t verticesNumber)
+{
+    float minimum[3], maximum[3];
+    PointsBounds(block, verticesNumber, minimum, maximum);
+
+    MergeBounds(bounds, { minimum[0], maximum[0], minimum[1], maximum[1], minimum[2], maximum[2] });
+}
+
+bool ReadBinaryStlHeader(const unsigned char* data, size_t size, unsigned int& trianglesNumber)
+{
+    if (size < STL_HEADER_SIZE)
+        return false;
+
+    std::memcpy(&trianglesNumber, data + 80, 4);
+
+    return (size - STL_HEADER_SIZE) / STL_RECORD_SIZE >= trianglesNumber;
+}
+
+StlBounds ParseBinaryStlRange(const unsigned char* data, size_t firstTriangle, size_t trianglesNumber, float* positions)
+{
+    StlBounds bounds = EmptyBounds();
+
+    const unsigned char* record = data + STL_HEADER_SIZE + firstTriangle * STL_RECORD_SIZE;
+    const size_t trianglesPerBlock = VERTICES_PER_BLOCK / 3;
+
+    float block[VERTICES_PER_BLOCK * 3];
+
+    for (size_t blockBegin = 0; blockBegin < trianglesNumber; blockBegin += trianglesPerBlock)
+    {
+        size_t blockSize = std::min(trianglesPerBlock, trianglesNumber - blockBegin);
+
+        // Records are 50 bytes long, so the vertices are not 4-byte aligned: memcpy compiles to unaligned loads
+        for (size_t triangle = 0; triangle < blockSize; triangle++)
+        {
+            std::memcpy(block + triangle * 9, record + 12, 9 * sizeof(float));
+            record += STL_RECORD_SIZE;
+        }
+
+        // The bounds are taken from the local copy, positions may be write-combined GPU memory that is slow to read
+        std::memcpy(positions + blockBegin * 9, block, blockSize * 9 * sizeof(float));
+        MergeBlockBounds(bounds, block, blockSize * 3);
+    }
+
+    return bounds;
+}
+
+StlBounds ParseBinaryStl(const unsigned char* data, size_t firstTriangle, size_t trianglesNumber, float* positions)
+{
+    std::vector<StlBounds> workerBounds(WorkerCount(trianglesNumber, MIN_TRIANGLES_PER_WORKER), EmptyBounds());
+
+    ParallelFor(trianglesNumber, MIN_TRIANGLES_PER_WORKER, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        workerBounds[worker] = ParseBinaryStlRange(data, firstTriangle + begin, end - begin, positions + begin * 9);
+    });
+
+    StlBounds bounds = EmptyBounds();
+    for (const StlBounds& other : workerBounds)
+        MergeBounds(bounds, other);
+
+    return bounds;
+}
+
+static bool IsSpace(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r') || (c == '\f') || (c == '\v');
+}
+
+static bool StartsWith(const char* p, const char* end, const char* keyword, size_t length)
+{
+    return (static_cast<size_t>(end - p) >= length) && (std::memcmp(p, keyword, length) == 0);
+}
+
+// 'v' occurs in no STL keyword other than "vertex" and in no number, so memchr finds the candidates
+static const char* FindVertex(const char* p, const char* begin, const char* end)
+{
+    while ((p = static_cast<const char*>(std::memchr(p, 'v', end - p))) != nullptr)
+    {
+        if (((p == begin) || IsSpace(p[-1])) && StartsWith(p, end, "vertex", 6) && ((p + 6 == end) || IsSpace(p[6])))
+            return p;
+        p++;
+    }
+    return nullptr;
+}
+
+static const char* ParseFloat(const char* p, const char* end, float& value)
+{
+    while ((p < end) && IsSpace(*p))
+        p++;
+
+    // from_chars rejects an explicit plus sign, which some exporters write
+    if ((p < end) && (*p == '+'))
+        p++;
+
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc())
+        return nullptr;
+
+    return result.ptr;
+}
+
+StlFormat DetectStlFormat(const unsigned char* data, size_t size)
+{
+    unsigned int trianglesNumber{ 0 };
+    bool recordsFit = ReadBinaryStlHeader(data, size, trianglesNumber);
+
+    if (recordsFit && (STL_HEADER_SIZE + trianglesNumber * STL_RECORD_SIZE == size))
+        return StlFormat::BINARY;
+
+    const char* text = reinterpret_cast<const char*>(data);
+    const char* end = text + size;
+    while ((text < end) && IsSpace(*text))
+        text++;
+
+    if (StartsWith(text, end, "solid", 5))
+        return StlFormat::ASCII;
+
+    return recordsFit ? StlFormat::BINARY : StlFormat::INVALID;
+}
+
+void SplitAsciiStl(const char* text, size_t size, size_t chunkSize, AsciiStlLayout& layout)
+{
+    const char* end = text + size;
+
+    // Skip the "solid <name>" line and cut the "endsolid <name>" line, the names are free text
+    const char* first = static_cast<const char*>(std::memchr(text, '\n', size));
+    first = (first != nullptr) ? first + 1 : end;
+
+    // Look for it only near the end, a file without one should not be scanned backwards in full
+    const char* searchLimit = (end - first > (1 << 16)) ? end - (1 << 16) : first;
+    for (const char* p = end; p - searchLimit >= 8; p--)
+    {
+        if (StartsWith(p - 8, end, "endsolid", 8))
+        {
+            end = p - 8;
+            break;
+        }
+    }
+
+    size_t textSize = end - first;
+    size_t chunksNumber = std::max<size_t>(1, textSize / std::max<size_t>(1, chunkSize));
+
+    layout.chunkBegin.assign(chunksNumber, 0);
+    layout.chunkEnd.assign(chunksNumber, 0);
+    layout.chunkTriangles.assign(chunksNumber, 0);
+    layout.chunkFirstTriangle.assign(chunksNumber, 0);
+    layout.trianglesNumber = 0;
+
+    // Move every split point forward to just after the next "endfacet"
+    size_t chunkBegin = first - text;
+    for (size_t chunk = 0; chunk < chunksNumber; chunk++)
+    {
+        const char* chunkEnd = end;
+
+        if (chunk + 1 < chunksNumber)
+        {
+            const char* p = std::max(text + chunkBegin, first + textSize * (chunk + 1) / chunksNumber);
+            while ((p = static_cast<const char*>(std::memchr(p, 'e', end - p))) != nullptr)
+            {
+                if (StartsWith(p, end, "endfacet", 8))
+                    break;
+                p++;
+            }
+            chunkEnd = (p != nullptr) ? p + 8 : end;
+        }
+
+        layout.chunkBegin[chunk] = chunkBegin;
+        layout.chunkEnd[chunk] = chunkEnd - text;
+        chunkBegin = chunkEnd - text;
+    }
+}
+
+void CountAsciiStl(const char* text, size_t firstChunk, size_t lastChunk, AsciiStlLayout& layout)
+{
+    ParallelFor(lastChunk - firstChunk, 1, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        for (size_t chunk = firstChunk + begin; chunk < firstChunk + end; chunk++)
+        {
+            const char* chunkBegin = text + layout.chunkBegin[chunk];
+            const char* chunkEnd = text + layout.chunkEnd[chunk];
+
+            size_t vertices{ 0 };
+            for (const char* p = chunkBegin; (p = FindVertex(p, chunkBegin, chunkEnd)) != nullptr; p += 6)
+                vertices++;
+
+            // A chunk holds whole facets, so anything but a multiple of three is malformed
+            layout.chunkTriangles[chunk] = (vertices % 3 == 0) ? vertices / 3 : SIZE_MAX;
+        }
+    });
+}
+
+bool PlaceAsciiStl(AsciiStlLayout& layout)
+{
+    layout.trianglesNumber = 0;
+
+    for (size_t chunk = 0; chunk < layout.chunkTriangles.size(); chunk++)
+    {
+        if (layout.chunkTriangles[chunk] == SIZE_MAX)
+            return false;
+
+        layout.chunkFirstTriangle[chunk] = layout.trianglesNumber;
+        layout.trianglesNumber += layout.chunkTriangles[chunk];
+    }
+
+    return true;
+}
+
+bool ParseAsciiStl(const char* text, const AsciiStlLayout& layout, size_t firstChunk, size_t lastChunk, float* positions, StlBounds& bounds)
+{
+    std::vector<StlBounds> chunkBounds(lastChunk - firstChunk, EmptyBounds());
+    std::atomic<bool> malformed{ false };
+
+    ParallelFor(lastChunk - firstChunk, 1, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        for (size_t chunk = firstChunk + begin; chunk < firstChunk + end; chunk++)
+        {
+            const char* chunkBegin = text + layout.chunkBegin[chunk];
+            const char* chunkEnd = text + layout.chunkEnd[chunk];
+
+            float* vertex = positions + (layout.chunkFirstTriangle[chunk] - layout.chunkFirstTriangle[firstChunk]) * 9;
+            StlBounds& vertexBounds = chunkBounds[chunk - firstChunk];
+
+            // Parsed into a local block first, positions may be write-combined GPU memory that is slow to read
+            float block[VERTICES_PER_BLOCK * 3];
+            size_t blockVertices{ 0 };
+
+            for (const char* p = chunkBegin; (p = FindVertex(p, chunkBegin, chunkEnd)) != nullptr; )
+            {
+                float* coordinates = block + blockVertices * 3;
+
+                p += 6;
+                if (((p = ParseFloat(p, chunkEnd, coordinates[0])) == nullptr) ||
+                    ((p = ParseFloat(p, chunkEnd, coordinates[1])) == nullptr) ||
+                    ((p = ParseFloat(p, chunkEnd, coordinates[2])) == nullptr))
+                {
+                    malformed = true;
+                    return;
+                }
+
+                if (++blockVertices == VERTICES_PER_BLOCK)
+                {
+                    std::memcpy(vertex, block, blockVertices * 3 * sizeof(float));
+                    MergeBlockBounds(vertexBounds, block, blockVertices);
+                    vertex += blockVertices * 3;
+                    blockVertices = 0;
+                }
+            }
+
+            std::memcpy(vertex, block, blockVertices * 3 * sizeof(float));
+            MergeBlockBounds(vertexBounds, block, blockVertices);
+        }
+    });
+
+    if (malformed)
+        return false;
+
+    for (const StlBounds& other : chunkBounds)
+        MergeBounds(bounds, other);
+
+    return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+struct StlBounds
+{
+    float minX, maxX, minY, maxY, minZ, maxZ;
+};
+
+// Binary STL layout: 80-byte header, 4-byte triangle count, then 50-byte records
+// (normal, three vertices, 2-byte attribute word)
+const size_t STL_HEADER_SIZE{ 84 };
+const size_t STL_RECORD_SIZE{ 50 };
+
+enum class StlFormat
+{
+    INVALID, BINARY, ASCII
+};
+
+// Text ranges of an ASCII STL, each ending right after an "endfacet", and where their triangles go
+struct AsciiStlLayout
+{
+    std::vector<size_t> chunkBegin;
+    std::vector<size_t> chunkEnd;
+    std::vector<size_t> chunkTriangles;
+    std::vector<size_t> chunkFirstTriangle;
+    size_t trianglesNumber{ 0 };
+};
+
+// Bounds that any point extends, so ranges without triangles do not disturb a reduction
+StlBounds EmptyBounds();
+void MergeBounds(StlBounds& bounds, const StlBounds& other);
+
+// Returns false if the mapped size cannot hold the triangle count from the header
+bool ReadBinaryStlHeader(const unsigned char* data, size_t size, unsigned int& trianglesNumber);
+
+// Copies the vertices of triangles [firstTriangle, firstTriangle + trianglesNumber) straight
+// from the mapped records to positions (9 floats per triangle, firstTriangle goes first)
+// and returns their bounds
+StlBounds ParseBinaryStlRange(const unsigned char* data, size_t firstTriangle, size_t trianglesNumber, float* positions);
+
+// Same, with the range split between worker threads that each write their own slice of
+// positions and keep their own bounds
+StlBounds ParseBinaryStl(const unsigned char* data, size_t firstTriangle, size_t trianglesNumber, float* positions);
+
+// A file is binary when its size matches the header's triangle count exactly, otherwise ASCII
+// when it starts with "solid", otherwise binary with trailing bytes if the records fit
+StlFormat DetectStlFormat(const unsigned char* data, size_t size);
+
+// Splits the text into chunks of about chunkSize bytes, each ending right after an "endfacet"
+void SplitAsciiStl(const char* text, size_t size, size_t chunkSize, AsciiStlLayout& layout);
+
+// Counts the triangles of chunks [firstChunk, lastChunk) in parallel
+void CountAsciiStl(const char* text, size_t firstChunk, size_t lastChunk, AsciiStlLayout& layout);
+
+// Once every chunk is counted, works out where their triangles go;
+// returns false if a chunk does not hold whole facets
+bool PlaceAsciiStl(AsciiStlLayout& layout);
+
+// Parses the vertices of chunks [firstChunk, lastChunk) in parallel into positions, starting with
+// the first triangle of firstChunk, and extends bounds with them; returns false if a vertex line is malformed
+bool ParseAsciiStl(const char* text, const AsciiStlLayout& layout, size_t firstChunk, size_t lastChunk, float* positions, StlBounds& bounds);
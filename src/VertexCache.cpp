@@ -0,0 +1,175 @@
+#include "VertexCache.h"
+
+#include <algorithm>
+#include <cstring>
+
+// FIFO cache simulated with timestamps: a vertex is cached while fewer than cacheSize misses
+// happened since its own
+class CacheSimulation
+{
+public:
+    CacheSimulation(size_t verticesNumber, unsigned int cacheSize)
+        : m_CacheTime(verticesNumber, 0), m_CacheSize(cacheSize), m_Time(cacheSize + 1)
+    {
+    }
+
+    // Returns 1 on a miss
+    unsigned int Fetch(uint32_t vertex)
+    {
+        if (m_Time - m_CacheTime[vertex] <= m_CacheSize)
+            return 0;
+
+        m_CacheTime[vertex] = m_Time++;
+        return 1;
+    }
+
+private:
+    std::vector<uint64_t> m_CacheTime;
+    uint64_t m_CacheSize;
+    uint64_t m_Time;
+};
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indicesNumber, size_t verticesNumber, unsigned int cacheSize)
+{
+    CacheSimulation cache(verticesNumber, cacheSize);
+
+    size_t misses{ 0 };
+    for (size_t index = 0; index < indicesNumber; index++)
+        misses += cache.Fetch(indices[index]);
+
+    VertexCacheStats stats;
+    stats.acmr = (indicesNumber > 0) ? (float)misses / (indicesNumber / 3) : 0.0f;
+    stats.atvr = (verticesNumber > 0) ? (float)misses / verticesNumber : 0.0f;
+
+    return stats;
+}
+
+void OptimizeVertexCache(uint32_t* indices, size_t indicesNumber, size_t verticesNumber, unsigned int cacheSize)
+{
+    size_t trianglesNumber = indicesNumber / 3;
+    if (trianglesNumber == 0)
+        return;
+
+    // Triangles around each vertex
+    std::vector<uint32_t> adjacencyOffsets(verticesNumber + 1, 0);
+    for (size_t index = 0; index < indicesNumber; index++)
+        adjacencyOffsets[indices[index] + 1]++;
+    for (size_t vertex = 0; vertex < verticesNumber; vertex++)
+        adjacencyOffsets[vertex + 1] += adjacencyOffsets[vertex];
+
+    std::vector<uint32_t> adjacency(indicesNumber);
+    std::vector<uint32_t> liveTriangles(verticesNumber);
+    for (size_t vertex = 0; vertex < verticesNumber; vertex++)
+        liveTriangles[vertex] = adjacencyOffsets[vertex + 1] - adjacencyOffsets[vertex];
+
+    {
+        std::vector<uint32_t> filled(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t index = 0; index < indicesNumber; index++)
+            adjacency[filled[indices[index]]++] = static_cast<uint32_t>(index / 3);
+    }
+
+    std::vector<uint64_t> cacheTime(verticesNumber, 0);
+    uint64_t time = cacheSize + 1;
+
+    std::vector<char> emitted(trianglesNumber, 0);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> ordered(indicesNumber);
+    size_t orderedTriangles{ 0 };
+    size_t nextVertex{ 1 };
+
+    int64_t fanning{ 0 };
+    while (fanning >= 0)
+    {
+        // Emit every triangle still left around the fanning vertex
+        candidates.clear();
+        for (uint32_t i = adjacencyOffsets[fanning]; i < adjacencyOffsets[fanning + 1]; i++)
+        {
+            uint32_t triangle = adjacency[i];
+            if (emitted[triangle])
+                continue;
+
+            for (int corner = 0; corner < 3; corner++)
+            {
+                uint32_t vertex = indices[triangle * 3 + corner];
+                ordered[orderedTriangles * 3 + corner] = vertex;
+
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                liveTriangles[vertex]--;
+
+                if (time - cacheTime[vertex] > cacheSize)
+                    cacheTime[vertex] = time++;
+            }
+
+            emitted[triangle] = 1;
+            orderedTriangles++;
+        }
+
+        // Fan next around the oldest candidate whose remaining triangles still fit before it is evicted
+        fanning = -1;
+        int64_t bestPriority{ -1 };
+        for (uint32_t vertex : candidates)
+        {
+            if (liveTriangles[vertex] == 0)
+                continue;
+
+            int64_t priority{ 0 };
+            if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+                priority = (int64_t)(time - cacheTime[vertex]);
+
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                fanning = vertex;
+            }
+        }
+
+        if (fanning >= 0)
+            continue;
+
+        // Dead end: go back to a recently used vertex, or on to the next one with triangles left
+        while (!deadEnds.empty() && (fanning < 0))
+        {
+            uint32_t vertex = deadEnds.back();
+            deadEnds.pop_back();
+            if (liveTriangles[vertex] > 0)
+                fanning = vertex;
+        }
+
+        while ((fanning < 0) && (nextVertex < verticesNumber))
+        {
+            if (liveTriangles[nextVertex] > 0)
+                fanning = nextVertex;
+            nextVertex++;
+        }
+    }
+
+    std::memcpy(indices, ordered.data(), indicesNumber * sizeof(uint32_t));
+}
+
+void OptimizeVertexFetch(uint32_t* indices, size_t indicesNumber, float* vertices, size_t verticesNumber)
+{
+    const uint32_t UNUSED{ UINT32_MAX };
+    std::vector<uint32_t> remap(verticesNumber, UNUSED);
+
+    uint32_t nextVertex{ 0 };
+    for (size_t index = 0; index < indicesNumber; index++)
+    {
+        uint32_t& vertex = remap[indices[index]];
+        if (vertex == UNUSED)
+            vertex = nextVertex++;
+        indices[index] = vertex;
+    }
+
+    // Vertices no triangle uses go last
+    for (size_t vertex = 0; vertex < verticesNumber; vertex++)
+        if (remap[vertex] == UNUSED)
+            remap[vertex] = nextVertex++;
+
+    std::vector<float> reordered(verticesNumber * 3);
+    for (size_t vertex = 0; vertex < verticesNumber; vertex++)
+        std::memcpy(&reordered[remap[vertex] * 3], vertices + vertex * 3, 3 * sizeof(float));
+
+    std::memcpy(vertices, reordered.data(), verticesNumber * 3 * sizeof(float));
+}
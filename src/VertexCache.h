@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Triangle order of an index buffer, recorded in the model cache so a cache written with another
+// order is rebuilt
+enum class IndexOrder : uint32_t
+{
+    WELDED = 0, VERTEX_CACHE = 1, VERTEX_CACHE_AND_OVERDRAW = 2
+};
+
+// Post-transform vertex cache simulated by the optimisation: FIFO, as on the hardware it was tuned for
+const unsigned int VERTEX_CACHE_SIZE{ 16 };
+
+// Average cache miss ratio (transformed vertices per triangle, 0.5 at best on a closed mesh) and
+// average transform to vertex ratio (transformed per unique vertex, 1 at best)
+struct VertexCacheStats
+{
+    float acmr;
+    float atvr;
+};
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indicesNumber, size_t verticesNumber, unsigned int cacheSize);
+
+// Reorders the triangles in place for vertex cache reuse (Tipsify: Sander, Nehab and Barczak 2007)
+void OptimizeVertexCache(uint32_t* indices, size_t indicesNumber, size_t verticesNumber, unsigned int cacheSize);
+
+// Renumbers vertices in the order the triangles first use them, so vertex fetch walks memory forwards
+void OptimizeVertexFetch(uint32_t* indices, size_t indicesNumber, float* vertices, size_t verticesNumber);
@@ -0,0 +1,81 @@
+#include "VertexFormat.h"
+
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const size_t MIN_VERTICES_PER_WORKER{ 1 << 16 };
+
+void EncodePositions(const float* positions, size_t verticesNumber, const StlBounds& bounds, VertexFormat format, void* vertices)
+{
+    if (format == VertexFormat::FLOAT)
+    {
+        std::memcpy(vertices, positions, verticesNumber * 3 * sizeof(float));
+        return;
+    }
+
+    float scale[3], offset[3];
+    PositionTransform(format, bounds, scale, offset);
+
+    uint16_t* quantized = static_cast<uint16_t*>(vertices);
+
+    ParallelFor(verticesNumber, MIN_VERTICES_PER_WORKER, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        for (size_t vertex = begin; vertex < end; vertex++)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float normalized = (positions[vertex * 3 + axis] - offset[axis]) / scale[axis];
+                normalized = std::min(1.0f, std::max(0.0f, normalized));
+                quantized[vertex * 3 + axis] = static_cast<uint16_t>(std::lround(normalized * 65535.0f));
+            }
+        }
+    });
+}
+
+void DecodePositions(const void* vertices, size_t verticesNumber, const StlBounds& bounds, VertexFormat format, float* positions)
+{
+    if (format == VertexFormat::FLOAT)
+    {
+        std::memcpy(positions, vertices, verticesNumber * 3 * sizeof(float));
+        return;
+    }
+
+    float scale[3], offset[3];
+    PositionTransform(format, bounds, scale, offset);
+
+    const uint16_t* quantized = static_cast<const uint16_t*>(vertices);
+
+    ParallelFor(verticesNumber, MIN_VERTICES_PER_WORKER, [&](size_t begin, size_t end, unsigned int worker)
+    {
+        for (size_t vertex = begin; vertex < end; vertex++)
+            for (int axis = 0; axis < 3; axis++)
+                positions[vertex * 3 + axis] = offset[axis] + scale[axis] * (quantized[vertex * 3 + axis] / 65535.0f);
+    });
+}
+
+void PositionTransform(VertexFormat format, const StlBounds& bounds, float scale[3], float offset[3])
+{
+    if (format == VertexFormat::FLOAT)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            scale[axis] = 1.0f;
+            offset[axis] = 0.0f;
+        }
+        return;
+    }
+
+    float minimum[3]{ bounds.minX, bounds.minY, bounds.minZ };
+    float maximum[3]{ bounds.maxX, bounds.maxY, bounds.maxZ };
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        offset[axis] = minimum[axis];
+
+        // A flat model still needs a scale to divide by, any will do
+        scale[axis] = (maximum[axis] > minimum[axis]) ? maximum[axis] - minimum[axis] : 1.0f;
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "StlLoader.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// How the welded vertex buffer stores positions
+enum class VertexFormat : uint32_t
+{
+    FLOAT = 0, QUANTIZED_16 = 1
+};
+
+// 3 floats, or 3 16-bit integers normalized across the model bounds
+inline size_t VertexSize(VertexFormat format)
+{
+    return (format == VertexFormat::QUANTIZED_16) ? 3 * sizeof(uint16_t) : 3 * sizeof(float);
+}
+
+// Converts 3-float positions inside bounds to the given format, in parallel
+void EncodePositions(const float* positions, size_t verticesNumber, const StlBounds& bounds, VertexFormat format, void* vertices);
+
+// Converts vertices in the given format back to 3-float positions, in parallel
+void DecodePositions(const void* vertices, size_t verticesNumber, const StlBounds& bounds, VertexFormat format, float* positions);
+
+// The shaders take scale * position + offset as the model-space position, where position is
+// normalized to [0, 1] when quantized
+void PositionTransform(VertexFormat format, const StlBounds& bounds, float scale[3], float offset[3]);